@@ -0,0 +1,55 @@
+// allocStats.cpp
+#include "allocStats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::size_t> COUNT{0};
+    std::atomic<std::size_t> BYTES{0};
+
+    void* countedAlloc(std::size_t n) {
+        COUNT.fetch_add(1, std::memory_order_relaxed);
+        BYTES.fetch_add(n, std::memory_order_relaxed);
+        if (void* p = std::malloc(n ? n : 1)) return p;
+        throw std::bad_alloc();
+    }
+
+    void* countedAlignedAlloc(std::size_t n, std::align_val_t al) {
+        std::size_t a = static_cast<std::size_t>(al);
+        COUNT.fetch_add(1, std::memory_order_relaxed);
+        BYTES.fetch_add(n, std::memory_order_relaxed);
+        // aligned_alloc wants a size that is a multiple of the alignment
+        if (void* p = std::aligned_alloc(a, ((n ? n : 1) + a - 1) / a * a)) return p;
+        throw std::bad_alloc();
+    }
+} // end anonymous namespace
+
+AllocCounters allocCounters() {
+    return AllocCounters{COUNT.load(std::memory_order_relaxed),
+                         BYTES.load(std::memory_order_relaxed)};
+}
+
+// ---------- replacement global allocation functions ----------
+
+void* operator new(std::size_t n) { return countedAlloc(n); }
+void* operator new[](std::size_t n) { return countedAlloc(n); }
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void* operator new(std::size_t n, std::align_val_t al) { return countedAlignedAlloc(n, al); }
+void* operator new[](std::size_t n, std::align_val_t al) { return countedAlignedAlloc(n, al); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
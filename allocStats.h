@@ -0,0 +1,17 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+#include <cstddef>
+
+
+// Process-wide heap allocation counters, fed by the replacement
+// operator new/delete in allocStats.cpp. Take a snapshot before and
+// after a piece of work and subtract to attribute allocations to it.
+struct AllocCounters {
+    std::size_t count;   // calls to operator new / new[]
+    std::size_t bytes;   // bytes requested by those calls
+};
+
+AllocCounters allocCounters();
+
+
+#endif // ALLOCSTATS_H
@@ -0,0 +1,40 @@
+// arena.cpp
+#include "arena.h"
+#include <stdexcept>
+
+void Arena::newBlock(std::size_t atLeast) {
+    if (atLeast > blockBytes) throw std::length_error("arena allocation larger than a block");
+    if (spare.empty()) {
+        blocks.push_back(static_cast<char*>(::operator new(blockBytes)));
+    } else {
+        blocks.push_back(spare.back());
+        spare.pop_back();
+    }
+    used = 0;
+}
+
+void Arena::releaseAll() {
+    for (char* b : blocks) ::operator delete(b);
+    for (char* b : spare) ::operator delete(b);
+    blocks.clear();
+    spare.clear();
+    used = 0;
+}
+
+void Arena::rewind(Mark m) {
+    while (blocks.size() > m.blocks) {
+        spare.push_back(blocks.back());
+        blocks.pop_back();
+    }
+    used = blocks.empty() ? 0 : m.used;
+}
+
+void Arena::reset(std::size_t keepBytes) {
+    rewind(Mark{0, 0});
+    std::size_t keep = keepBytes / blockBytes;
+    if (spare.size() <= keep) return;
+    // spare.back() is the next block handed out; free from the front
+    std::size_t excess = spare.size() - keep;
+    for (std::size_t i = 0; i < excess; ++i) ::operator delete(spare[i]);
+    spare.erase(spare.begin(), spare.begin() + static_cast<std::ptrdiff_t>(excess));
+}
@@ -0,0 +1,58 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <vector>
+
+
+// Bump allocator: carves objects out of large blocks and frees them
+// all at once. Only for trivially destructible types, since nothing is
+// ever destroyed individually.
+class Arena {
+public:
+    explicit Arena(std::size_t blockBytes = 256 * 1024) : blockBytes(blockBytes) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { releaseAll(); }
+
+    void* allocate(std::size_t bytes, std::size_t align) {
+        std::size_t at = (used + align - 1) & ~(align - 1);
+        if (blocks.empty() || at + bytes > blockBytes) {
+            newBlock(bytes);
+            at = 0;
+        }
+        used = at + bytes;
+        return blocks.back() + at;
+    }
+
+    // Free every block
+    void releaseAll();
+
+    // Free everything allocated, but keep up to keepBytes of blocks for
+    // the next round, so a reused arena does not go back to the heap
+    // for sizes it has already seen. Blocks beyond that are returned.
+    void reset(std::size_t keepBytes);
+
+    // A point in the allocation sequence; rewind() frees everything
+    // allocated after it. Blocks past the mark are kept for reuse, so
+    // rewinding once per statement does not churn the heap.
+    struct Mark {
+        std::size_t blocks;
+        std::size_t used;
+    };
+    Mark mark() const { return Mark{blocks.size(), used}; }
+    void rewind(Mark m);
+
+    // Bytes obtained from the heap (block granularity)
+    std::size_t reserved() const { return blocks.size() * blockBytes; }
+
+private:
+    void newBlock(std::size_t atLeast);
+
+    std::size_t blockBytes;
+    std::size_t used = 0;             // bytes used in the last block
+    std::vector<char*> blocks;
+    std::vector<char*> spare;         // emptied by rewind(), reused first
+};
+
+
+#endif // ARENA_H
@@ -0,0 +1,54 @@
+// batch.cpp (compile many programs at once: compile a b c ...)
+#include "batch.h"
+#include "workPool.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+    struct Result {
+        int status = 0;
+        std::string out;
+        std::string err;
+        std::string stats;
+    };
+
+    void printPrefixed(std::ostream& os, const std::string& text, const std::string& prefix) {
+        std::istringstream lines(text);
+        for (std::string line; std::getline(lines, line); )
+            os << prefix << line << '\n';
+    }
+} // end anonymous namespace
+
+int compileBatch(const std::vector<const char*>& bases, const CompileOptions& opts,
+                 unsigned jobs, std::ostream* stats) {
+    if (!jobs) jobs = std::thread::hardware_concurrency();
+    if (jobs > bases.size()) jobs = static_cast<unsigned>(bases.size());
+
+    std::vector<Result> results(bases.size());
+    WorkStealingPool pool(jobs);
+    pool.run(bases.size(), [&](std::size_t i) {
+        // the context (and its mapped source) lives only for this file
+        CompileContext cx(opts);
+        results[i].status = compileFile(cx, bases[i]);
+        results[i].out = cx.out.str();
+        results[i].err = cx.err.str();
+        if (stats) {
+            std::ostringstream json;
+            writeStatsJson(json, cx.stats, (std::string(bases[i]) + ".fs25s2").c_str(),
+                           results[i].status);
+            results[i].stats = json.str();
+        }
+    });
+
+    int status = 0;
+    for (std::size_t i = 0; i < bases.size(); ++i) {
+        std::string prefix = std::string(bases[i]) + ".fs25s2: ";
+        printPrefixed(std::cout, results[i].out, prefix);
+        printPrefixed(std::cerr, results[i].err, prefix);
+        if (stats) *stats << results[i].stats;
+        if (results[i].status) status = 1;
+    }
+    return status;
+}
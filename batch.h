@@ -0,0 +1,18 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <ostream>
+#include <vector>
+#include "compiler.h"
+
+
+// Compile every <base>.fs25s2 in `bases`, each into its own <base>.asm,
+// on `jobs` threads (0 means one per core). Each file gets its own
+// CompileContext. Diagnostics are printed in argument order once all
+// files are done, and every line is prefixed with "<base>.fs25s2: ".
+// With `stats`, one --stats JSON line per file is written there, also in
+// argument order. Returns 0 if every file compiled.
+int compileBatch(const std::vector<const char*>& bases, const CompileOptions& opts,
+                 unsigned jobs, std::ostream* stats = nullptr);
+
+
+#endif // BATCH_H
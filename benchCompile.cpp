@@ -0,0 +1,400 @@
+// benchCompile.cpp (compiler throughput benchmark behind `make bench`)
+//
+// Generates valid programs of growing size in several shapes, compiles
+// each in-process with the phase timers of --stats, and reports the
+// cost of every phase per size. Sizes grow tenfold, so a phase whose
+// time grows faster than the size (log-log slope above --slope) is
+// flagged as superlinear.
+#include "compiler.h"
+#include "optimizer.h"
+#include "version.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    // ---------- program generator ----------
+
+    // Each shape stresses one dimension; `size` counts statements (for
+    // decls, declarations). Deep is a single nest `size` levels deep,
+    // the worst case for anything that recurses on nesting; wide is
+    // sqrt(size) statements of sqrt(size) operands.
+    const char* const SHAPES[] = {"flat", "deep", "wide", "decls"};
+
+    bool isShape(const std::string& s) {
+        for (const char* sh : SHAPES)
+            if (s == sh) return true;
+        return false;
+    }
+
+    std::size_t isqrt(std::size_t n) {
+        std::size_t r = static_cast<std::size_t>(std::sqrt(static_cast<double>(n)));
+        return r ? r : 1;
+    }
+
+    // "id_" and five base-36 digits: distinct names for any size used here
+    std::string varName(std::size_t i) {
+        std::string name = "id_00000";
+        for (std::size_t pos = name.size(); pos-- > 3 && i; i /= 36)
+            name[pos] = "0123456789abcdefghijklmnopqrstuvwxyz"[i % 36];
+        return name;
+    }
+
+    const char* const HEADER = "start var id_a ~ 1 id_b ~ 2 id_c ~ 3 id_d ~ 4 :\n{\n";
+
+    // Long list of mixed simple statements
+    void genFlat(std::ostream& os, std::size_t size) {
+        os << HEADER;
+        for (std::size_t i = 0; i < size; ++i) {
+            int k = static_cast<int>(i % 97) + 1;
+            switch (i % 5) {
+                case 0: os << "  set id_a ~ id_b + " << k << " * 3 :\n"; break;
+                case 1: os << "  print id_a - id_c % " << k << " :\n"; break;
+                case 2: os << "  read id_b :\n"; break;
+                case 3: os << "  if [ id_a < id_c ] set id_c ~ id_c + 1 :\n"; break;
+                case 4: os << "  while [ id_d > " << k << " ] set id_d ~ id_d - 1 :\n"; break;
+            }
+        }
+        os << "}\ntrats\n";
+    }
+
+    // Nested if/while/blocks, each level counting as a statement, with
+    // parentheses nested as deep in the innermost assignment
+    void genDeep(std::ostream& os, std::size_t size) {
+        os << HEADER;
+        for (std::size_t l = 0; l < size; ++l) {
+            switch (l % 3) {
+                case 0: os << "if [ id_a > " << l % 1000 << " ] {\n"; break;
+                case 1: os << "while [ id_b neq 0 ] {\n"; break;
+                case 2: os << "{ set id_c ~ id_c + 1 :\n"; break;
+            }
+        }
+        os << "set id_d ~ ";
+        for (std::size_t l = 0; l < size; ++l) os << "( ";
+        os << "id_a";
+        for (std::size_t l = 0; l < size; ++l) os << " + 1 )";
+        os << " :\n";
+        for (std::size_t l = 0; l < size; ++l) os << "}\n";
+        os << "}\ntrats\n";
+    }
+
+    // Assignments with long operator chains
+    void genWide(std::ostream& os, std::size_t size) {
+        static const char* const OPS[] = {" + ", " - ", " * ", " % "};
+        static const char* const VARS[] = {"id_a", "id_b", "id_c", "id_d"};
+        std::size_t width = isqrt(size);
+        os << HEADER;
+        for (std::size_t done = 0; done < size; done += width) {
+            os << "set id_a ~ id_b";
+            for (std::size_t t = 0; t < width; ++t) {
+                os << OPS[t % 4];
+                if (t % 2) os << VARS[t % 4];
+                else os << (t % 9) + 1;
+            }
+            os << " :\n";
+        }
+        os << "}\ntrats\n";
+    }
+
+    // Many declarations, each read once so none is unused
+    void genDecls(std::ostream& os, std::size_t size) {
+        os << "start var";
+        for (std::size_t i = 0; i < size; ++i) os << ' ' << varName(i) << " ~ 0";
+        os << " :\n{\n";
+        for (std::size_t i = 0; i < size; ++i) os << "  read " << varName(i) << " :\n";
+        os << "}\ntrats\n";
+    }
+
+    void generate(std::ostream& os, const std::string& shape, std::size_t size) {
+        if (shape == "flat") genFlat(os, size);
+        else if (shape == "deep") genDeep(os, size);
+        else if (shape == "wide") genWide(os, size);
+        else genDecls(os, size);
+    }
+
+    // ---------- measurement ----------
+
+    struct PhaseTime {
+        std::string name;
+        double wallMs;
+        double cpuMs;
+    };
+
+    struct Run {
+        std::string shape;
+        std::size_t size;
+        std::size_t bytes;
+        std::size_t tokens;
+        std::vector<PhaseTime> phases;   // "total" last
+        std::vector<double> slopes;      // per phase; NAN for the first size
+    };
+
+    struct Flag {
+        std::string shape;
+        std::string phase;
+        std::size_t from;
+        std::size_t to;
+        double slope;
+    };
+
+    // Below this a phase's time is mostly noise and its slope is not judged
+    const double MIN_JUDGED_MS = 1.0;
+
+    // Small inputs are compiled this many times and the fastest run kept
+    const int SMALL_REPEATS = 3;
+    const std::size_t SMALL_SIZE = 100000;
+
+    // Best of `repeats` compiles of inPath; false if the compile fails
+    bool measure(const CompileOptions& opts, const std::string& inPath,
+                 const std::string& outPath, int repeats, Run& run) {
+        CompileContext cx(opts);
+        double best = -1.0;
+        for (int r = 0; r < repeats; ++r) {
+            cx.reset();
+            if (compilePaths(cx, inPath, outPath) != 0) {
+                std::cerr << cx.out.str() << cx.err.str();
+                return false;
+            }
+            PhaseTime total{"total", 0.0, 0.0};
+            std::vector<PhaseTime> phases;
+            for (const PhaseStats& p : cx.stats.phases) {
+                phases.push_back(PhaseTime{p.name, p.wallMs, p.cpuMs});
+                total.wallMs += p.wallMs;
+                total.cpuMs += p.cpuMs;
+            }
+            phases.push_back(total);
+            if (best < 0.0 || total.wallMs < best) {
+                best = total.wallMs;
+                run.phases = phases;
+                run.tokens = cx.stats.tokens;
+            }
+        }
+        return true;
+    }
+
+    // "10K", "1M" and the like (decimal); false on a malformed count
+    bool parseCount(const char* s, std::size_t& n) {
+        char* end;
+        unsigned long long v = std::strtoull(s, &end, 10);
+        if (end == s) return false;
+        switch (*end) {
+            case 'K': v *= 1000; ++end; break;
+            case 'M': v *= 1000000; ++end; break;
+            default: break;
+        }
+        if (*end || v == 0) return false;
+        n = static_cast<std::size_t>(v);
+        return true;
+    }
+
+    void writeCsv(std::ostream& os, const std::string& label, const std::vector<Run>& runs) {
+        os << "label,shape,statements,bytes,tokens,phase,wall_ms,cpu_ms,ns_per_statement,slope\n";
+        for (const Run& r : runs) {
+            for (std::size_t i = 0; i < r.phases.size(); ++i) {
+                const PhaseTime& p = r.phases[i];
+                os << label << ',' << r.shape << ',' << r.size << ',' << r.bytes << ','
+                   << r.tokens << ',' << p.name << ',' << p.wallMs << ',' << p.cpuMs << ','
+                   << p.wallMs * 1e6 / static_cast<double>(r.size) << ',';
+                if (!std::isnan(r.slopes[i])) os << r.slopes[i];
+                os << '\n';
+            }
+        }
+    }
+
+    // Labels and shape/phase names are plain words, so no escaping
+    void writeJson(std::ostream& os, const std::string& label, const std::string& options,
+                   const std::vector<Run>& runs, const std::vector<Flag>& flags) {
+        os << "{\"label\":\"" << label << "\",\"version\":\"" << COMPILER_VERSION
+           << "\",\"options\":\"" << options << "\",\"runs\":[";
+        for (std::size_t k = 0; k < runs.size(); ++k) {
+            const Run& r = runs[k];
+            if (k) os << ',';
+            os << "\n{\"shape\":\"" << r.shape << "\",\"statements\":" << r.size
+               << ",\"bytes\":" << r.bytes << ",\"tokens\":" << r.tokens << ",\"phases\":[";
+            for (std::size_t i = 0; i < r.phases.size(); ++i) {
+                const PhaseTime& p = r.phases[i];
+                if (i) os << ',';
+                os << "{\"name\":\"" << p.name << "\",\"wall_ms\":" << p.wallMs
+                   << ",\"cpu_ms\":" << p.cpuMs << ",\"ns_per_statement\":"
+                   << p.wallMs * 1e6 / static_cast<double>(r.size) << ",\"slope\":";
+                if (std::isnan(r.slopes[i])) os << "null";
+                else os << r.slopes[i];
+                os << '}';
+            }
+            os << "]}";
+        }
+        os << "],\n\"superlinear\":[";
+        for (std::size_t k = 0; k < flags.size(); ++k) {
+            const Flag& f = flags[k];
+            if (k) os << ',';
+            os << "{\"shape\":\"" << f.shape << "\",\"phase\":\"" << f.phase << "\",\"from\":"
+               << f.from << ",\"to\":" << f.to << ",\"slope\":" << f.slope << '}';
+        }
+        os << "]}\n";
+    }
+
+    int usage() {
+        std::cerr << "Usage: benchCompile [--shapes=flat,deep,wide,decls] [--min=N] [--max=N]\n"
+                     "                    [--slope=X] [--csv=<file>] [--json=<file>] [--label=<text>]\n"
+                     "                    [--stream] [--pipeline] [-O0 | -O1 | -O2] [--strict]\n"
+                     "       benchCompile --gen=<shape> --size=N   (program on stdout)\n"
+                     "N takes K/M suffixes (decimal); sizes go from --min to --max tenfold.\n";
+        return 1;
+    }
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> shapes(std::begin(SHAPES), std::end(SHAPES));
+    std::size_t minSize = 1000;
+    std::size_t maxSize = 1000000;
+    double maxSlope = 1.25;
+    const char* csvPath = nullptr;
+    const char* jsonPath = nullptr;
+    std::string label = "unlabeled";
+    std::string options;
+    bool strict = false;
+    std::string genShape;
+    std::size_t genSize = 0;
+    CompileOptions opts;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (std::strncmp(a, "--shapes=", 9) == 0) {
+            shapes.clear();
+            std::string list = a + 9;
+            for (std::size_t at = 0; at <= list.size(); ) {
+                std::size_t comma = list.find(',', at);
+                if (comma == std::string::npos) comma = list.size();
+                std::string s = list.substr(at, comma - at);
+                if (!isShape(s)) return usage();
+                shapes.push_back(s);
+                at = comma + 1;
+            }
+        } else if (std::strncmp(a, "--min=", 6) == 0) {
+            if (!parseCount(a + 6, minSize)) return usage();
+        } else if (std::strncmp(a, "--max=", 6) == 0) {
+            if (!parseCount(a + 6, maxSize)) return usage();
+        } else if (std::strncmp(a, "--slope=", 8) == 0) {
+            maxSlope = std::atof(a + 8);
+        } else if (std::strncmp(a, "--csv=", 6) == 0) {
+            csvPath = a + 6;
+        } else if (std::strncmp(a, "--json=", 7) == 0) {
+            jsonPath = a + 7;
+        } else if (std::strncmp(a, "--label=", 8) == 0) {
+            label = a + 8;
+        } else if (std::strcmp(a, "--stream") == 0) {
+            opts.stream = true;
+            options += " --stream";
+        } else if (std::strcmp(a, "--pipeline") == 0) {
+            opts.scanMode = ScanMode::Pipelined;
+            options += " --pipeline";
+        } else if (std::strcmp(a, "-O0") == 0 || std::strcmp(a, "-O1") == 0 ||
+                   std::strcmp(a, "-O2") == 0) {
+            opts.passes = passesForLevel(a[2] - '0');
+            options += std::string(" ") + a;
+        } else if (std::strcmp(a, "--strict") == 0) {
+            strict = true;
+        } else if (std::strncmp(a, "--gen=", 6) == 0) {
+            genShape = a + 6;
+            if (!isShape(genShape)) return usage();
+        } else if (std::strncmp(a, "--size=", 7) == 0) {
+            if (!parseCount(a + 7, genSize)) return usage();
+        } else {
+            return usage();
+        }
+    }
+
+    if (!genShape.empty()) {
+        if (!genSize) return usage();
+        generate(std::cout, genShape, genSize);
+        return 0;
+    }
+    if (minSize > maxSize) return usage();
+
+    char dirTemplate[] = "/tmp/benchCompileXXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        std::cerr << "ERROR: cannot create a scratch directory\n";
+        return 1;
+    }
+    const std::string dir = dirTemplate;
+    const std::string inPath = dir + "/prog.fs25s2";
+    const std::string outPath = dir + "/prog.asm";
+
+    std::vector<Run> runs;
+    std::vector<Flag> flags;
+    int status = 0;
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const std::string& shape : shapes) {
+        std::cout << shape << ":\n";
+        const std::size_t first = runs.size();   // this shape's first run
+        for (std::size_t size = minSize; size <= maxSize; size *= 10) {
+            Run run{shape, size, 0, 0, {}, {}};
+            {
+                std::ofstream prog(inPath);
+                generate(prog, shape, size);
+                run.bytes = static_cast<std::size_t>(prog.tellp());
+            }
+            int repeats = size < SMALL_SIZE ? SMALL_REPEATS : 1;
+            if (!measure(opts, inPath, outPath, repeats, run)) {
+                std::cerr << "ERROR: generated " << shape << " program of " << size
+                          << " statements did not compile\n";
+                status = 1;
+                break;
+            }
+
+            // slope of log(time) against log(size) since the previous size
+            const Run* prev = runs.size() > first ? &runs.back() : nullptr;
+            run.slopes.assign(run.phases.size(), NAN);
+            for (std::size_t i = 0; prev && i < run.phases.size(); ++i) {
+                const PhaseTime& now = run.phases[i];
+                if (i >= prev->phases.size() || prev->phases[i].name != now.name) continue;
+                double before = prev->phases[i].wallMs;
+                if (before <= 0.0 || now.wallMs <= 0.0) continue;
+                double slope = std::log(now.wallMs / before) /
+                               std::log(double(size) / double(prev->size));
+                run.slopes[i] = slope;
+                if (slope > maxSlope && now.wallMs >= MIN_JUDGED_MS)
+                    flags.push_back(Flag{shape, now.name, prev->size, size, slope});
+            }
+
+            std::cout << "  " << std::setw(9) << size << " statements, "
+                      << std::setw(10) << run.bytes << " bytes:";
+            for (const PhaseTime& p : run.phases)
+                std::cout << ' ' << p.name << ' ' << p.wallMs << " ms";
+            std::cout << " (" << run.phases.back().wallMs * 1e6 / double(size)
+                      << " ns/statement)\n";
+
+            runs.push_back(run);
+            if (size > maxSize / 10) break;
+        }
+    }
+    std::remove(inPath.c_str());
+    std::remove(outPath.c_str());
+    rmdir(dir.c_str());
+
+    for (const Flag& f : flags)
+        std::cout << "SUPERLINEAR: " << f.shape << ' ' << f.phase << " from " << f.from
+                  << " to " << f.to << " statements, slope " << f.slope << '\n';
+    if (flags.empty()) std::cout << "no superlinear phases (slope limit " << maxSlope << ")\n";
+
+    if (csvPath) {
+        std::ofstream csv(csvPath);
+        writeCsv(csv, label, runs);
+    }
+    if (jsonPath) {
+        std::ofstream json(jsonPath);
+        writeJson(json, label, options.empty() ? "" : options.substr(1), runs, flags);
+    }
+    if (strict && !flags.empty()) status = 1;
+    return status;
+}
@@ -0,0 +1,142 @@
+// benchLex.cpp (lexer throughput benchmark behind `compile --bench-lex`)
+#include "scanner.h"
+#include "allocStats.h"
+#include "compiler.h"
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+    const char* EXT = ".fs25s2";
+
+    // A pass must repeat at least this often, and for at least this long
+    const int MIN_PASSES = 10;
+    const double MIN_SECONDS = 1.0;
+
+    // Size of the synthetic corpus used when no file is given
+    const std::size_t SYNTHETIC_BYTES = 8 * 1024 * 1024;
+
+    const char* modeName(ScanMode m) {
+        switch (m) {
+            case ScanMode::Direct:    return "direct";
+            case ScanMode::Parallel:  return "parallel";
+            case ScanMode::Pipelined: return "pipelined";
+        }
+        return "?";
+    }
+
+    // Write `s` to `f` and add its length to `bytes`; false on a write error
+    bool put(const char* s, FILE* f, std::size_t& bytes) {
+        if (std::fputs(s, f) == EOF) return false;
+        bytes += std::char_traits<char>::length(s);
+        return true;
+    }
+
+    // Valid program exercising every token group, comments and indentation;
+    // nullptr if it cannot be written
+    FILE* syntheticCorpus() {
+        FILE* f = std::tmpfile();
+        if (!f) return nullptr;
+
+        static const char* const STATS[] = {
+            "    set id_a ~ id_b * 3 + ( id_c - 42 ) % 7 :\n",
+            "    if [ id_a >= 10 ] print id_b : # threshold check #\n",
+            "    while [ id_c neq 0 ] { read id_c : set id_c ~ - id_c : }\n",
+            "    if [ id_b eq id_a ] { print 12345678 * id_a : }\n",
+            "\t\tset id_b ~ id_b - 1 : # countdown #\n",
+        };
+        std::size_t bytes = 0;
+        bool ok = put("start var id_a ~ 1 id_b ~ 2 id_c ~ 3 :\n{\n", f, bytes);
+        for (std::size_t i = 0; ok && bytes < SYNTHETIC_BYTES; ++i)
+            ok = put(STATS[i % (sizeof(STATS) / sizeof(STATS[0]))], f, bytes);
+        if (!ok || !put("}\ntrats\n", f, bytes) || std::fflush(f) == EOF) {
+            std::fclose(f);
+            return nullptr;
+        }
+        return f;
+    }
+} // end anonymous namespace
+
+int testScanner(const char* fileBase, ScanMode mode) {
+    using Clock = std::chrono::steady_clock;
+
+    std::string source = "synthetic corpus";
+    FILE* in;
+    if (fileBase) {
+        source = std::string(fileBase) + EXT;
+        in = std::fopen(source.c_str(), "r");
+        if (!in) {
+            std::cerr << "ERROR: cannot open input file '" << source << "'\n";
+            return 1;
+        }
+    } else {
+        in = syntheticCorpus();
+        if (!in) {
+            std::cerr << "ERROR: cannot create synthetic corpus\n";
+            return 1;
+        }
+    }
+
+    std::size_t kinds[sizeof(tokenKindName) / sizeof(tokenKindName[0])] = {};
+    std::size_t tokens = 0;
+    int passes = 0;
+    double total = 0.0;
+    double best = 0.0;
+    AllocCounters allocs{0, 0};
+    Interner syms;
+    Scanner scan;
+
+    // pass -1 warms the page cache and is not timed
+    for (int pass = -1; passes < MIN_PASSES || total < MIN_SECONDS; ++pass) {
+        AllocCounters before = allocCounters();
+        auto t0 = Clock::now();
+
+        std::size_t n = 0;
+        try {
+            scan.open(in, syms, std::cerr, mode);
+            for (Token tk = scan.next(); ; tk = scan.next()) {
+                ++n;
+                if (pass == 0) kinds[static_cast<int>(tk.kind)]++;
+                if (tk.id == TokenID::EOFTk) break;
+            }
+        } catch (const CompileError&) {
+            std::fclose(in);
+            return 1;
+        }
+
+        double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+        AllocCounters after = allocCounters();
+        if (pass < 0) continue;
+
+        if (pass == 0) {
+            tokens = n;
+            allocs = AllocCounters{after.count - before.count, after.bytes - before.bytes};
+        }
+        if (passes == 0 || secs < best) best = secs;
+        total += secs;
+        ++passes;
+    }
+    std::fseek(in, 0, SEEK_END);
+    std::size_t bytes = static_cast<std::size_t>(std::ftell(in));
+    std::fclose(in);
+
+    double mean = total / passes;
+    std::cout << std::fixed << std::setprecision(2)
+              << "bench-lex: " << source << ", " << bytes << " bytes, "
+              << passes << " passes, mode " << modeName(mode) << '\n'
+              << "  tokens/pass    " << tokens << '\n'
+              << "  best pass      " << best * 1e3 << " ms\n"
+              << "  mean pass      " << mean * 1e3 << " ms\n"
+              << "  tokens/sec     " << static_cast<long long>(tokens / best) << '\n'
+              << "  MB/sec         " << bytes / best / 1e6 << '\n'
+              << "  allocs/pass    " << allocs.count << " (" << allocs.bytes << " bytes)\n"
+              << "  token kinds:\n";
+    for (std::size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); ++k) {
+        if (!kinds[k]) continue;
+        std::cout << "    " << std::left << std::setw(12) << tokenKindName[k]
+                  << std::right << kinds[k] << '\n';
+    }
+    return 0;
+}
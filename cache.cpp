@@ -0,0 +1,239 @@
+// cache.cpp (content-addressed compile cache)
+#include "cache.h"
+#include "compiler.h"
+#include "version.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char* ENTRY_EXT = ".entry";
+    const char* MAGIC = "P4CACHE";
+
+    // FNV-1a, 128-bit
+    struct Fnv128 {
+        unsigned __int128 h = (static_cast<unsigned __int128>(0x6c62272e07bb0142ULL) << 64) |
+                              0x62b821756295c58dULL;
+
+        void add(const char* p, std::size_t n) {
+            const unsigned __int128 prime = (static_cast<unsigned __int128>(0x0000000001000000ULL) << 64) |
+                                            0x000000000000013BULL;
+            for (std::size_t i = 0; i < n; ++i) {
+                h ^= static_cast<unsigned char>(p[i]);
+                h *= prime;
+            }
+        }
+        void add(const std::string& s) { add(s.c_str(), s.size() + 1); }   // with the '\0' as separator
+
+        std::string hex() const {
+            char buf[33];
+            std::snprintf(buf, sizeof(buf), "%016llx%016llx",
+                          static_cast<unsigned long long>(h >> 64),
+                          static_cast<unsigned long long>(h));
+            return buf;
+        }
+    };
+
+    // Device, inode, size and mtime of the running executable. Any
+    // rebuild or reinstall changes it, so output from a binary with
+    // different code generation is never served; empty if unknown.
+    const std::string& buildId() {
+        static const std::string id = [] {
+            struct stat st;
+            if (::stat("/proc/self/exe", &st) != 0) return std::string();
+            std::ostringstream ss;
+            ss << st.st_dev << ':' << st.st_ino << ':' << st.st_size << ':'
+               << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec;
+            return ss.str();
+        }();
+        return id;
+    }
+
+    bool readFile(const std::string& path, std::string& data) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        data = ss.str();
+        return true;
+    }
+
+    bool endsWith(const std::string& s, const char* suffix) {
+        std::size_t n = std::strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    struct DirEntry {
+        std::string path;
+        std::uint64_t size;
+        struct timespec mtime;
+    };
+
+    // Every cache entry in `dir`, with its size and last use
+    std::vector<DirEntry> listEntries(const std::string& dir) {
+        std::vector<DirEntry> entries;
+        DIR* d = ::opendir(dir.c_str());
+        if (!d) return entries;
+        while (dirent* e = ::readdir(d)) {
+            std::string name = e->d_name;
+            if (!endsWith(name, ENTRY_EXT)) continue;
+            std::string path = dir + "/" + name;
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0) continue;
+            entries.push_back(DirEntry{path, static_cast<std::uint64_t>(st.st_size), st.st_mtim});
+        }
+        ::closedir(d);
+        return entries;
+    }
+} // end anonymous namespace
+
+CompileCache::CompileCache(std::string dir, std::uint64_t limit)
+    : dir(std::move(dir)), limit(limit) {}
+
+bool CompileCache::open() {
+    if (::mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        std::cerr << "ERROR: cannot create cache directory '" << dir << "': "
+                  << std::strerror(errno) << '\n';
+        return false;
+    }
+    return true;
+}
+
+std::string CompileCache::key(const char* source, std::size_t size, const std::string& optionsKey) {
+    Fnv128 h;
+    h.add(COMPILER_VERSION);
+    h.add(buildId());
+    h.add(optionsKey);
+    h.add(source, size);
+    return h.hex();
+}
+
+std::string CompileCache::entryPath(const std::string& key) const {
+    return dir + "/" + key + ENTRY_EXT;
+}
+
+// Entry layout: "P4CACHE <out bytes> <err bytes> <asm bytes>\n" followed
+// by the three texts in that order
+bool CompileCache::fetch(const std::string& key, CompileContext& cx, const std::string& outPath) {
+    std::string path = entryPath(key);
+    std::string data;
+    std::size_t outBytes, errBytes, asmBytes;
+    char magic[8];
+    std::size_t eol;
+    if (!readFile(path, data) ||
+        (eol = data.find('\n')) == std::string::npos ||
+        std::sscanf(data.c_str(), "%7s %zu %zu %zu", magic, &outBytes, &errBytes, &asmBytes) != 4 ||
+        std::strcmp(magic, MAGIC) != 0 ||
+        data.size() != eol + 1 + outBytes + errBytes + asmBytes) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out || !out.write(data.data() + eol + 1 + outBytes + errBytes,
+                           static_cast<std::streamsize>(asmBytes))) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    cx.out.write(data.data() + eol + 1, static_cast<std::streamsize>(outBytes));
+    cx.err.write(data.data() + eol + 1 + outBytes, static_cast<std::streamsize>(errBytes));
+
+    ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);   // recently used: evict last
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void CompileCache::store(const std::string& key, const CompileContext& cx, const std::string& outPath) {
+    std::string program;
+    if (!readFile(outPath, program)) return;
+    std::string out = cx.out.str();
+    std::string err = cx.err.str();
+
+    std::ostringstream entry;
+    entry << MAGIC << ' ' << out.size() << ' ' << err.size() << ' ' << program.size() << '\n'
+          << out << err << program;
+    std::string data = entry.str();
+
+    // unique temporary name, then an atomic rename into place
+    std::string tmp = dir + "/.tmp." + std::to_string(::getpid()) + "." +
+                      std::to_string(tempSerial.fetch_add(1));
+    {
+        std::ofstream f(tmp, std::ios::binary);
+        if (!f || !f.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+            ::unlink(tmp.c_str());
+            return;
+        }
+    }
+    // An entry already stored for this key (a concurrent compile of the
+    // same source got there first) is replaced, so only the difference
+    // counts. sizeLock keeps this thread's stat and rename together.
+    const std::string path = entryPath(key);
+    std::lock_guard<std::mutex> g(sizeLock);
+    struct stat old;
+    std::uint64_t replaced = ::stat(path.c_str(), &old) == 0 ? static_cast<std::uint64_t>(old.st_size) : 0;
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return;
+    }
+    stores.fetch_add(1, std::memory_order_relaxed);
+    evictIfNeeded(data.size(), replaced);
+}
+
+// The directory is measured once per process and then tracked locally;
+// other processes' additions are picked up whenever the limit is hit,
+// since eviction re-lists the directory.
+void CompileCache::evictIfNeeded(std::uint64_t added, std::uint64_t replaced) {
+    if (sizeKnown) {
+        // the replaced entry may be one another process wrote after we
+        // measured, so it need not be in `bytes`
+        bytes += added;
+        bytes -= std::min(bytes, replaced);
+    } else {
+        measure();   // already includes the new entry
+    }
+    if (bytes <= limit) return;
+
+    // oldest first; trim to 90% so eviction is not needed on every store
+    std::vector<DirEntry> entries = listEntries(dir);
+    std::sort(entries.begin(), entries.end(), [](const DirEntry& a, const DirEntry& b) {
+        return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec
+                                                : a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+    bytes = 0;
+    for (const DirEntry& e : entries) bytes += e.size;
+    const std::uint64_t target = limit / 10 * 9;
+    for (const DirEntry& e : entries) {
+        if (bytes <= target) break;
+        if (::unlink(e.path.c_str()) == 0) {
+            bytes -= e.size;
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CompileCache::measure() const {
+    bytes = 0;
+    for (const DirEntry& e : listEntries(dir)) bytes += e.size;
+    sizeKnown = true;
+}
+
+CacheStats CompileCache::stats() const {
+    std::lock_guard<std::mutex> g(sizeLock);
+    if (!sizeKnown) measure();
+    return CacheStats{hits.load(), misses.load(), stores.load(), evictions.load(), bytes, limit};
+}
+
+std::ostream& operator<<(std::ostream& os, const CacheStats& st) {
+    return os << "cache: " << st.hits << " hits, " << st.misses << " misses, "
+              << st.stores << " stored, " << st.evictions << " evicted, "
+              << st.bytes << " of " << st.limit << " bytes used\n";
+}
@@ -0,0 +1,74 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+struct CompileContext;
+
+
+struct CacheStats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t stores;
+    std::uint64_t evictions;   // entries removed to stay under the limit
+    std::uint64_t bytes;       // size of the cache directory (as far as this process knows)
+    std::uint64_t limit;
+};
+
+// "cache: H hits, M misses, ..." on one line
+std::ostream& operator<<(std::ostream& os, const CacheStats& st);
+
+
+// On-disk, content-addressed cache of finished compilations. An entry
+// is keyed by a 128-bit hash of the source bytes, COMPILER_VERSION,
+// the identity of the compiler binary (a rebuild starts a fresh set of
+// keys) and the output-relevant options. It holds the .asm text together with
+// the messages the compile printed, so a hit replays exactly what a
+// real compile would have produced. Entries are written to a temporary
+// file and renamed into place, so concurrent compilers (threads or
+// processes) sharing a directory never see a partial entry. When the
+// directory grows past `limit` bytes, the least recently used entries
+// (by mtime, refreshed on every hit) are deleted.
+class CompileCache {
+public:
+    CompileCache(std::string dir, std::uint64_t limit);
+
+    // False (with a message on stderr) if the directory cannot be created
+    bool open();
+
+    // Key for compiling `source` with options summarized by `optionsKey`
+    static std::string key(const char* source, std::size_t size, const std::string& optionsKey);
+
+    // On a hit, write the cached program to outPath, put the cached
+    // messages into cx and return true
+    bool fetch(const std::string& key, CompileContext& cx, const std::string& outPath);
+
+    // Record a successful compile whose program is in outPath
+    void store(const std::string& key, const CompileContext& cx, const std::string& outPath);
+
+    CacheStats stats() const;
+
+private:
+    std::string entryPath(const std::string& key) const;
+    void evictIfNeeded(std::uint64_t added, std::uint64_t replaced);   // sizeLock held
+    void measure() const;   // list the directory; sizeLock held
+
+    std::string dir;
+    std::uint64_t limit;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> stores{0};
+    std::atomic<std::uint64_t> evictions{0};
+    std::atomic<std::uint64_t> tempSerial{0};
+
+    mutable std::mutex sizeLock;   // guards the size bookkeeping below
+    mutable bool sizeKnown = false;
+    mutable std::uint64_t bytes = 0;
+};
+
+
+#endif // CACHE_H
@@ -1,300 +1,448 @@
 #include "codeGen.h"
+#include "compiler.h"
 #include "node.h"
-#include <unordered_set>
+#include "intern.h"
+#include "ir.h"
+#include "optimizer.h"
+#include <cstdio>
+#include <memory>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 
-static int tempCount = 0;
-static int labelCount = 0;
-
-static std::unordered_set<std::string> vars;
-static std::vector<std::string> temps;
-static std::vector<std::string> code;
-
 /* ---------- helpers ---------- */
 
-static void emit(const std::string& s) { code.push_back(s); }
-
-static std::string newTemp() {
-    std::string t = "_t" + std::to_string(tempCount++);
-    temps.push_back(t);
-    return t;
-}
-
-static std::string newLabel(const std::string& base) {
-    return base + std::to_string(labelCount++);
-}
-
 static bool isId(const Token& t)  { return t.id == TokenID::IDENT_tk; }
 static bool isNum(const Token& t) { return t.id == TokenID::NUM_tk; }
+static std::string text(const Token& t) { return std::string(t.instance); }
 
-/* ---------- variable collection ---------- */
-
-static void collectVars(Node* n) {
-    if (!n) return;
-
-    if (isId(n->tk1)) vars.insert(n->tk1.instance);
-    if (isId(n->tk2)) vars.insert(n->tk2.instance);
-    if (isId(n->tk3)) vars.insert(n->tk3.instance);
-
-    collectVars(n->child1);
-    collectVars(n->child2);
-    collectVars(n->child3);
-    collectVars(n->child4);
+// Value of a NUM token (at most 8 digits, so it fits an int)
+static int numValue(const Token& t) {
+    int v = 0;
+    for (char c : t.instance.view()) v = v * 10 + (c - '0');
+    return v;
 }
 
-/* ---------- expressions (MATCHES YOUR PARSER) ---------- */
-
-static std::string genExpr(Node* n);
-static std::string genM(Node* n);
-static std::string genN(Node* n);
-static std::string genR(Node* n);
+// Statements are generated from an explicit work stack, so neither long
+// statement lists nor deep nesting use the C++ call stack. A work item
+// either visits a node or emits an instruction that was deferred until
+// its body (pushed after it, so popped first) has been generated.
+struct StatWork {
+    Node* node;         // node to visit (may be null)
+    bool deferred;      // emit `instr` instead
+    IrInstr instr;
+};
+
+namespace {
+    // Lowers statements to IR in `unit`
+    class Generator {
+    public:
+        IrUnit unit;
+        int labelCount = 0;
+
+        void genStat(Node* root);
+
+    private:
+
+        std::vector<StatWork> work;   // genStat()'s stack, kept between calls
+
+        // genExpr()'s stacks, kept between calls: an EXP, M or N level
+        // whose spine is being walked, and the operands collected on it
+        struct ExprLevel {
+            NodeType type;
+            Node* at;           // spine node reached (null once it runs out)
+            std::size_t base;   // its first entry in `operands`
+        };
+        struct ExprOperand {
+            Node* op;           // spine node whose operator takes it
+            IrOperand value;    // left operand (unused for unary -)
+            bool unary;
+        };
+        std::vector<ExprLevel> levels;
+        std::vector<ExprOperand> operands;
+
+        void emit(const IrInstr& i) { unit.code.push_back(i); }
+
+        void emit(IrOp op, IrOperand dst, IrOperand a, IrOperand b = IrOperand()) {
+            emit(IrInstr{op, IrRel::Eq, dst, a, b, -1});
+        }
 
-static std::string genR(Node* n) {
-    if (!n) return "";
+        IrOperand newTemp() {
+            return IrOperand::temp(unit.tempCount++);
+        }
 
-    // R -> IDENT | NUM | ( exp )
-    if (isId(n->tk1)) return n->tk1.instance;
+        int newLabel(IrLabelKind kind) {
+            return unit.addLabel(kind, labelCount++);
+        }
 
-    if (isNum(n->tk1)) {
-        std::string t = newTemp();
-        emit("LOAD " + n->tk1.instance);
-        emit("STORE " + t);
-        return t;
-    }
+        IrOperand var(const Token& t) { return unit.useVar(t.sym, t.instance); }
 
-    // ( exp )
-    if (n->child1) return genExpr(n->child1);
+        IrOperand genExpr(Node* n);
+        Node* enterN(ExprLevel& level);
+        IrOperand genModulo(IrOperand a, IrOperand b);
+        void genRelFalseFromParent(const Token& op, IrOperand left, Node* rightExp, int lab);
+    };
+} // end anonymous namespace
 
-    return "";
-}
+/* ---------- expressions (MATCHES YOUR PARSER) ---------- */
 
 // Helper: emit code for (a % b) into a fresh temp using DIV/MULT/SUB (no MOD instruction!)
-static std::string genModulo(const std::string& a, const std::string& b) {
+IrOperand Generator::genModulo(IrOperand a, IrOperand b) {
     // q = a / b
-    std::string q = newTemp();
-    emit("LOAD " + a);
-    emit("DIV " + b);
-    emit("STORE " + q);
+    IrOperand q = newTemp();
+    emit(IrOp::Div, q, a, b);
 
     // prod = q * b
-    std::string prod = newTemp();
-    emit("LOAD " + q);
-    emit("MULT " + b);
-    emit("STORE " + prod);
+    IrOperand prod = newTemp();
+    emit(IrOp::Mul, prod, q, b);
 
     // r = a - prod
-    std::string r = newTemp();
-    emit("LOAD " + a);
-    emit("SUB " + prod);
-    emit("STORE " + r);
+    IrOperand r = newTemp();
+    emit(IrOp::Sub, r, a, prod);
 
     return r;
 }
 
-// N -> - N | R % N | R
-// In your parser: base R in child1, '%' in tk2, RHS N in child2
-static std::string genN(Node* n) {
-    if (!n) return "";
-
-    // unary -
-    if (n->tk1.instance == "-") {
-        std::string rhs = genN(n->child1);
-        std::string t = newTemp();
-        emit("LOAD 0");
-        emit("SUB " + rhs);
-        emit("STORE " + t);
-        return t;
-    }
-
-    std::string left = genR(n->child1);
-
-    // percent
-    if (n->tk2.instance == "%" && n->child2) {
-        std::string right = genN(n->child2);
-        return genModulo(left, right);   // ✅ uses DIV/MULT/SUB
-    }
-
-    return left;
-}
-
-// M -> N * M | N
-// In your parser: '*' in tk1, left N in child1, right M in child2
-static std::string genM(Node* n) {
-    if (!n) return "";
-
-    std::string left = genN(n->child1);
-
-    if (n->tk1.instance == "*" && n->child2) {
-        std::string right = genM(n->child2);
-        std::string t = newTemp();
-        emit("LOAD " + left);
-        emit("MULT " + right);
-        emit("STORE " + t);
-        return t;
+// The grammar is right-recursive, so operator chains become long
+// child2 spines. Each spine is walked in a loop: operands are generated
+// left to right, then combined from the innermost operator out
+// (a - b - c is a - (b - c)), giving the same code and temp numbering
+// as the recursive form. Parentheses nest a new EXP level inside an R;
+// the levels being walked are kept on `levels`, so neither operator
+// count nor parenthesis depth uses the C++ call stack.
+//
+// In your parser:
+// EXP: +|- in tk1, left M in child1, right EXP in child2
+// M:   '*' in tk1, left N in child1, right M in child2
+// N:   unary '-' in tk1 with operand N in child1,
+//      or base R in child1, '%' in tk2, RHS N in child2
+// R:   identifier or integer in tk1, or ( exp ) with the EXP in child1
+
+// Step past the unary minuses starting at level.at; returns the R the
+// N chain continues with
+Node* Generator::enterN(ExprLevel& level) {
+    Node* n = level.at;
+    while (n && n->tk1().kind == TokenKind::MINUS_tk) {
+        operands.push_back(ExprOperand{n, IrOperand(), true});
+        n = n->child1();
     }
-
-    return left;
+    level.at = n;
+    return n ? n->child1() : nullptr;
 }
 
-// EXP -> M + EXP | M - EXP | M
-// In your parser: +|- in tk1, left M in child1, right EXP in child2
-static std::string genExpr(Node* n) {
-    if (!n) return "";
-
-    std::string left = genM(n->child1);
+IrOperand Generator::genExpr(Node* root) {
+    std::size_t base = levels.size();
+    Node* node = root;
+    IrOperand value;
+
+    for (;;) {
+        // descend to a leaf, opening a level per spine entered
+        for (;;) {
+            if (!node) {
+                value = IrOperand();
+                break;
+            }
+            NodeType type = node->label;
+            if (type == NodeType::EXP || type == NodeType::M) {
+                levels.push_back(ExprLevel{type, node, operands.size()});
+                node = node->child1();
+            } else if (type == NodeType::N) {
+                levels.push_back(ExprLevel{type, node, operands.size()});
+                node = enterN(levels.back());
+            } else if (isId(node->tk1())) {
+                value = var(node->tk1());
+                break;
+            } else if (isNum(node->tk1())) {
+                value = newTemp();
+                emit(IrOp::Copy, value, unit.addConst(numValue(node->tk1()), node->tk1().instance));
+                break;
+            } else {
+                node = node->child1();     // ( exp )
+            }
+        }
 
-    if ((n->tk1.instance == "+" || n->tk1.instance == "-") && n->child2) {
-        std::string right = genExpr(n->child2);
-        std::string t = newTemp();
-        emit("LOAD " + left);
-        emit((n->tk1.instance == "+") ? ("ADD " + right) : ("SUB " + right));
-        emit("STORE " + t);
-        return t;
+        // climb: `value` completes the innermost level's current operand
+        for (;;) {
+            if (levels.size() == base) return value;
+            ExprLevel& level = levels.back();
+            Node* at = level.at;
+
+            if (level.type == NodeType::N) {
+                if (at && at->tk2().kind == TokenKind::PERCENT_tk && at->child2()) {
+                    operands.push_back(ExprOperand{at, value, false});
+                    level.at = at->child2();
+                    node = enterN(level);
+                    break;
+                }
+                for (std::size_t i = operands.size(); i-- > level.base; ) {
+                    if (operands[i].unary) {
+                        IrOperand t = newTemp();
+                        emit(IrOp::Sub, t, unit.addConst(0), value);
+                        value = t;
+                    } else {
+                        value = genModulo(operands[i].value, value);   // ✅ uses DIV/MULT/SUB
+                    }
+                }
+            } else {
+                operands.push_back(ExprOperand{at, value, false});
+                TokenKind k = at->tk1().kind;
+                bool more = level.type == NodeType::M ? k == TokenKind::STAR_tk
+                                                      : k == TokenKind::PLUS_tk || k == TokenKind::MINUS_tk;
+                if (more && at->child2()) {
+                    level.at = at->child2();
+                    node = level.at->child1();
+                    break;
+                }
+                value = operands.back().value;
+                for (std::size_t i = operands.size() - 1; i-- > level.base; ) {
+                    IrOperand t = newTemp();
+                    IrOp op = level.type == NodeType::M ? IrOp::Mul
+                            : operands[i].op->tk1().kind == TokenKind::PLUS_tk ? IrOp::Add : IrOp::Sub;
+                    emit(op, t, operands[i].value, value);
+                    value = t;
+                }
+            }
+            operands.resize(level.base);
+            levels.pop_back();
+        }
     }
-
-    return left;
 }
 
 /* ---------- conditionals (MATCHES YOUR PARSER) ---------- */
 
-// Branch to lab when (leftVar op rightExp) is FALSE
-static void genRelFalseFromParent(const std::string& op,
-                                  const std::string& leftVar,
-                                  Node* rightExp,
-                                  const std::string& lab) {
-    std::string right = genExpr(rightExp);
-
-    emit("LOAD " + leftVar);
-    emit("SUB " + right);
-
-    if (op == ">") {
-        emit("BRNEG " + lab);
-        emit("BRZERO " + lab);
-    } else if (op == "<") {
-        emit("BRPOS " + lab);
-        emit("BRZERO " + lab);
-    } else if (op == ">=") {
-        emit("BRNEG " + lab);
-    } else if (op == "<=") {
-        emit("BRPOS " + lab);
-    } else if (op == "eq") {
-        emit("BRNEG " + lab);
-        emit("BRPOS " + lab);
-    } else if (op == "neq") {
-        emit("BRZERO " + lab);
-    } else {
-        throw std::runtime_error("Unknown relational operator: " + op);
+// Branch to lab when (left op rightExp) is FALSE
+void Generator::genRelFalseFromParent(const Token& op, IrOperand left, Node* rightExp, int lab) {
+    IrOperand right = genExpr(rightExp);
+
+    IrRel rel;
+    switch (op.kind) {
+        case TokenKind::GT_tk:  rel = IrRel::Le; break;
+        case TokenKind::LT_tk:  rel = IrRel::Ge; break;
+        case TokenKind::GE_tk:  rel = IrRel::Lt; break;
+        case TokenKind::LE_tk:  rel = IrRel::Gt; break;
+        case TokenKind::EQ_tk:  rel = IrRel::Ne; break;
+        case TokenKind::NEQ_tk: rel = IrRel::Eq; break;
+        default:
+            throw std::runtime_error("Unknown relational operator: " + text(op));
     }
+    emit(IrInstr{IrOp::JumpIf, rel, IrOperand(), left, right, lab});
 }
 
 /* ---------- statements ---------- */
 
-static void genStat(Node* n);
-
-static void genStats(Node* n) {
-    if (!n) return;
-    genStat(n->child1);
-    genStats(n->child2);
-}
-
-static std::string getAssignTarget(Node* n) {
-    if (isId(n->tk2)) return n->tk2.instance;
-    if (n->child1 && isId(n->child1->tk1)) return n->child1->tk1.instance;
+static const Token& getAssignTarget(Node* n) {
+    if (isId(n->tk2())) return n->tk2();
+    if (n->child1() && isId(n->child1()->tk1())) return n->child1()->tk1();
     throw std::runtime_error("ASSIGN missing target");
 }
 
-static std::string getReadTarget(Node* n) {
-    if (isId(n->tk2)) return n->tk2.instance;
-    if (n->child1 && isId(n->child1->tk1)) return n->child1->tk1.instance;
+static const Token& getReadTarget(Node* n) {
+    if (isId(n->tk2())) return n->tk2();
+    if (n->child1() && isId(n->child1()->tk1())) return n->child1()->tk1();
     throw std::runtime_error("READ missing identifier");
 }
 
-static void genStat(Node* n) {
-    if (!n) return;
+static IrInstr labelInstr(int label) {
+    return IrInstr{IrOp::Label, IrRel::Eq, IrOperand(), IrOperand(), IrOperand(), label};
+}
 
-    switch (n->label) {
-        case NodeType::READ: {
-            emit("READ " + getReadTarget(n));
-            break;
-        }
+void Generator::genStat(Node* root) {
+    work.push_back(StatWork{root, false, IrInstr{}});
 
-        case NodeType::PRINT: {
-            emit("WRITE " + genExpr(n->child1));
-            break;
-        }
+    while (!work.empty()) {
+        StatWork w = work.back();
+        work.pop_back();
 
-        case NodeType::ASSIGN: {
-            std::string id = getAssignTarget(n);
-            Node* rhs = (n->child2 ? n->child2 : n->child1);
-            std::string v = genExpr(rhs);
-            emit("LOAD " + v);
-            emit("STORE " + id);
-            break;
+        if (w.deferred) {
+            emit(w.instr);
+            continue;
+        }
+        Node* n = w.node;
+        if (!n) continue;
+
+        switch (n->label) {
+            case NodeType::READ: {
+                emit(IrOp::Read, var(getReadTarget(n)), IrOperand());
+                break;
+            }
+
+            case NodeType::PRINT: {
+                emit(IrOp::Write, IrOperand(), genExpr(n->child1()));
+                break;
+            }
+
+            case NodeType::ASSIGN: {
+                IrOperand id = var(getAssignTarget(n));
+                Node* rhs = (n->child2() ? n->child2() : n->child1());
+                IrOperand v = genExpr(rhs);
+                emit(IrOp::Copy, id, v);
+                break;
+            }
+
+            case NodeType::COND: {
+                // COND: tk2=left IDENT, child1=REL(op), child2=EXP(right), child3=STAT(body)
+                int end = newLabel(IrLabelKind::EndIf);
+                IrOperand left = var(n->tk2());
+                Token op = (n->child1() ? n->child1()->tk1() : NO_TOKEN);
+
+                genRelFalseFromParent(op, left, n->child2(), end);
+
+                work.push_back(StatWork{nullptr, true, labelInstr(end)});
+                work.push_back(StatWork{n->child3(), false, IrInstr{}});
+                break;
+            }
+
+            case NodeType::LOOP: {
+                // LOOP: tk2=left IDENT, child1=REL(op), child2=EXP(right), child3=STAT(body)
+                int top = newLabel(IrLabelKind::While);
+                int end = newLabel(IrLabelKind::EndWhile);
+
+                emit(labelInstr(top));
+
+                IrOperand left = var(n->tk2());
+                Token op = (n->child1() ? n->child1()->tk1() : NO_TOKEN);
+
+                genRelFalseFromParent(op, left, n->child2(), end);
+
+                work.push_back(StatWork{nullptr, true, labelInstr(end)});
+                work.push_back(StatWork{nullptr, true,
+                    IrInstr{IrOp::Jump, IrRel::Eq, IrOperand(), IrOperand(), IrOperand(), top}});
+                work.push_back(StatWork{n->child3(), false, IrInstr{}});
+                break;
+            }
+
+            case NodeType::BLOCK: {
+                work.push_back(StatWork{n->child2(), false, IrInstr{}});
+                break;
+            }
+
+            case NodeType::STATS:
+            case NodeType::MSTAT: {
+                // list cell: this statement, then the rest of the list
+                work.push_back(StatWork{n->child2(), false, IrInstr{}});
+                work.push_back(StatWork{n->child1(), false, IrInstr{}});
+                break;
+            }
+
+            default:
+                work.push_back(StatWork{n->child1(), false, IrInstr{}});
         }
+    }
+}
 
-        case NodeType::COND: {
-            // COND: tk2=left IDENT, child1=REL(op), child2=EXP(right), child3=STAT(body)
-            std::string end = newLabel("ENDIF");
-            std::string left = n->tk2.instance;
-            std::string op = (n->child1 ? n->child1->tk1.instance : "");
+/* ---------- entry ---------- */
 
-            genRelFalseFromParent(op, left, n->child2, end);
-            genStat(n->child3);
+// Storage directives (declared variables, then temporaries); returns
+// the number of variables
+static std::size_t writeStorage(CompileContext& cx, std::ostream& out,
+                                const StorageCollector& storage, int tempCount) {
+    const std::vector<bool>& vars = storage.vars();
+    std::size_t varCount = 0;
+    for (int sym = 0; sym < static_cast<int>(vars.size()); ++sym) {
+        if (!vars[static_cast<std::size_t>(sym)]) continue;
+        out << cx.symbols.name(sym) << " 0\n";
+        ++varCount;
+    }
+    for (int t = 0; t < tempCount; ++t) out << "_t" << t << " 0\n";
+    return varCount;
+}
 
-            emit(end + ": NOOP");   // ✅ label syntax
-            break;
-        }
+static void recordStats(CompileContext& cx, std::size_t varCount, const Generator& gen,
+                        std::size_t instructions) {
+    cx.stats.variables = varCount;
+    cx.stats.temps = static_cast<std::size_t>(gen.unit.tempCount);
+    cx.stats.labels = static_cast<std::size_t>(gen.labelCount);
+    cx.stats.instructions = instructions + 1;
+}
 
-        case NodeType::LOOP: {
-            // LOOP: tk2=left IDENT, child1=REL(op), child2=EXP(right), child3=STAT(body)
-            std::string top = newLabel("WHILE");
-            std::string end = newLabel("ENDWHILE");
+// Optimize the generated IR, select instructions, and optimize those
+static void lowerUnit(CompileContext& cx, IrUnit& unit) {
+    runIrPasses(cx, unit);
+    selectTarget(unit);
+    runTargetPasses(cx, unit);
+}
 
-            emit(top + ": NOOP");   // ✅ label syntax
+void generateTarget(CompileContext& cx, Node* root, std::ostream& out) {
+    StorageCollector storage;
+    traverse(root, storage);
+    generateTarget(cx, root, out, storage);
+}
 
-            std::string left = n->tk2.instance;
-            std::string op = (n->child1 ? n->child1->tk1.instance : "");
+void generateTarget(CompileContext& cx, Node* root, std::ostream& out,
+                    const StorageCollector& storage) {
+    Generator gen;
+    runTreePasses(cx, root);
+    if (root && root->child2())
+        gen.genStat(root->child2());
+    lowerUnit(cx, gen.unit);
 
-            genRelFalseFromParent(op, left, n->child2, end);
-            genStat(n->child3);
+    std::size_t varCount = writeStorage(cx, out, storage, gen.unit.tempCount);
 
-            emit("BR " + top);
-            emit(end + ": NOOP");   // ✅ label syntax
-            break;
-        }
+    // code
+    writeTarget(gen.unit, out);
 
-        case NodeType::BLOCK: {
-            genStats(n->child2);
-            break;
-        }
+    out << "STOP\n";
 
-        default:
-            genStat(n->child1);
-    }
+    recordStats(cx, varCount, gen, gen.unit.target.size());
 }
 
-/* ---------- entry ---------- */
-
-void generateTarget(Node* root, std::ostream& out) {
-    vars.clear();
-    temps.clear();
-    code.clear();
-    tempCount = 0;
-    labelCount = 0;
+/* ---------- streaming ---------- */
+
+struct StatementGenerator::State {
+    Generator gen;      // its unit holds one statement's code at a time
+    std::ostringstream text;   // one statement's assembly, reused
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> spool{nullptr, std::fclose};
+    std::size_t spooled = 0;   // instructions written to the spool
+};
+
+StatementGenerator::StatementGenerator(CompileContext& cx)
+    : cx(cx), st(std::make_unique<State>()) {
+    st->spool.reset(std::tmpfile());
+    if (!st->spool) {
+        cx.err << "ERROR: cannot create temporary file for generated code\n";
+        throw CompileError{};
+    }
+}
 
-    collectVars(root);
+StatementGenerator::~StatementGenerator() = default;
 
-    if (root && root->child2)
-        genStat(root->child2);
+void StatementGenerator::spoolError() {
+    cx.err << "ERROR: cannot write or read back the temporary file for generated code\n";
+    throw CompileError{};
+}
 
-    // storage
-    for (const auto& v : vars) out << v << " 0\n";
-    for (const auto& t : temps) out << t << " 0\n";
+void StatementGenerator::statement(Node* stat) {
+    Generator& gen = st->gen;
+    runTreePasses(cx, stat);
+    gen.genStat(stat);
+    lowerUnit(cx, gen.unit);
+
+    st->text.str(std::string());
+    writeTarget(gen.unit, st->text);
+    const std::string& lines = st->text.str();
+    if (std::fwrite(lines.data(), 1, lines.size(), st->spool.get()) != lines.size())
+        spoolError();
+    st->spooled += gen.unit.target.size();
+    gen.unit.clearCode();
+}
 
-    // code
-    for (const auto& c : code) out << c << "\n";
+void StatementGenerator::finish(std::ostream& out, const StorageCollector& storage) {
+    std::size_t varCount = writeStorage(cx, out, storage, st->gen.unit.tempCount);
+
+    // code, copied back from the spool
+    // (rewind() clears the error indicator, so buffered writes are
+    // flushed and checked first)
+    std::FILE* spool = st->spool.get();
+    if (std::fflush(spool) == EOF || std::ferror(spool)) spoolError();
+    std::rewind(spool);
+    char buf[64 * 1024];
+    std::size_t n;
+    while ((n = std::fread(buf, 1, sizeof buf, spool)) > 0)
+        out.write(buf, static_cast<std::streamsize>(n));
+    if (std::ferror(spool)) spoolError();
 
     out << "STOP\n";
+
+    recordStats(cx, varCount, st->gen, st->spooled);
 }
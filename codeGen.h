@@ -1,9 +1,75 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include <memory>
 #include <ostream>
+#include <string>
+#include <vector>
 #include "node.h"
+#include "visitor.h"
 
-void generateTarget(Node* root, std::ostream& out);
+struct CompileContext;
+
+// Tree pass marking every identifier that needs a storage slot, by
+// symbol ID. Run it in a traversal shared with other passes (see
+// visitor.h), or let the parser drive it in single-pass mode, and hand
+// it to generateTarget().
+class StorageCollector : public TreePass {
+public:
+    const std::vector<bool>& vars() const { return used; }
+
+    using TreePass::visit;
+    void visit(NodeTag<NodeType::VARS>, Node* n, int)    { mark(n->tk2()); }
+    void visit(NodeTag<NodeType::VARLIST>, Node* n, int) { mark(n->tk1()); }
+    void visit(NodeTag<NodeType::READ>, Node* n, int)    { mark(n->tk2()); }
+    void visit(NodeTag<NodeType::COND>, Node* n, int)    { mark(n->tk2()); }
+    void visit(NodeTag<NodeType::LOOP>, Node* n, int)    { mark(n->tk2()); }
+    void visit(NodeTag<NodeType::ASSIGN>, Node* n, int)  { mark(n->tk2()); }
+    void visit(NodeTag<NodeType::R>, Node* n, int)       { mark(n->tk1()); }
+
+private:
+    void mark(const Token& tk) {
+        if (tk.id != TokenID::IDENT_tk) return;
+        std::size_t i = static_cast<std::size_t>(tk.sym);
+        if (i >= used.size()) used.resize(i + 1, false);   // grows as symbols are seen
+        used[i] = true;
+    }
+    std::vector<bool> used;   // indexed by interned symbol ID
+};
+
+// Write the target program for cx's parse tree to `out`, after the
+// optimization passes in cx.opts
+void generateTarget(CompileContext& cx, Node* root, std::ostream& out);
+
+// Same, with storage already collected
+void generateTarget(CompileContext& cx, Node* root, std::ostream& out,
+                    const StorageCollector& storage);
+
+// Streaming code generation: statements are generated (and optimized)
+// one at a time as the parser finishes them, their code spooled to a
+// temporary file, and finish() writes the storage directives followed
+// by the spooled code. Between statements only the temp and label
+// counters (and variable spellings) are kept, so at -O0 the output matches generateTarget() on
+// the whole tree; passes cannot look across statements.
+// The constructor reports "ERROR: ..." on cx.err and throws
+// CompileError if no temporary file can be created.
+class StatementGenerator {
+public:
+    explicit StatementGenerator(CompileContext& cx);
+    ~StatementGenerator();
+
+    // Generate one statement (a STAT node)
+    void statement(Node* stat);
+
+    void finish(std::ostream& out, const StorageCollector& storage);
+
+private:
+    // Report a failed spool write or read and abandon the compile
+    [[noreturn]] void spoolError();
+
+    struct State;
+    CompileContext& cx;
+    std::unique_ptr<State> st;
+};
 
 #endif
@@ -0,0 +1,397 @@
+// codeQuality.cpp (generated-code regression check behind `make codequality`)
+//
+// Compiles every <name>.fs25s2 in the corpus directory at -O0 and -O2,
+// runs the .asm on a small accumulator-machine VM with <name>.in as
+// input, and records per program and level:
+//   static   instructions in the program (labels' NOOPs and STOP included)
+//   slots    storage directives (variables and _tN temps)
+//   dynamic  instructions executed before STOP
+// The output must match <name>.out at every level, and no number may
+// exceed the checked-in baseline. --update rewrites the baseline from
+// the current compiler (and writes any missing .out from -O0).
+#include "compiler.h"
+#include "optimizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+    const char* EXT = ".fs25s2";
+    const char* BASELINE = "baseline.txt";
+    const int LEVELS[] = {0, 2};
+
+    // ---------- VM ----------
+
+    enum class Op {
+        ADD, BR, BRNEG, BRZNEG, BRPOS, BRZPOS, BRZERO, COPY, DIV,
+        LOAD, MULT, NOOP, READ, STOP, STORE, SUB, WRITE
+    };
+
+    const std::unordered_map<std::string, Op> OPCODES = {
+        {"ADD", Op::ADD},     {"BR", Op::BR},         {"BRNEG", Op::BRNEG},
+        {"BRZNEG", Op::BRZNEG}, {"BRPOS", Op::BRPOS}, {"BRZPOS", Op::BRZPOS},
+        {"BRZERO", Op::BRZERO}, {"COPY", Op::COPY},   {"DIV", Op::DIV},
+        {"LOAD", Op::LOAD},   {"MULT", Op::MULT},     {"NOOP", Op::NOOP},
+        {"READ", Op::READ},   {"STOP", Op::STOP},     {"STORE", Op::STORE},
+        {"SUB", Op::SUB},     {"WRITE", Op::WRITE}
+    };
+
+    // How many operands each opcode takes
+    int arity(Op op) {
+        switch (op) {
+            case Op::NOOP: case Op::STOP: return 0;
+            case Op::COPY: return 2;
+            default: return 1;
+        }
+    }
+
+    bool isBranch(Op op) {
+        return op == Op::BR || op == Op::BRNEG || op == Op::BRZNEG || op == Op::BRPOS ||
+               op == Op::BRZPOS || op == Op::BRZERO;
+    }
+
+    // An immediate, a storage slot, or (for branches) an instruction index
+    struct Operand {
+        bool immediate = false;
+        long long value = 0;
+        std::size_t index = 0;
+    };
+
+    struct Instr {
+        Op op;
+        Operand a;
+        Operand b;
+    };
+
+    struct Machine {
+        std::vector<Instr> code;
+        std::vector<long long> memory;
+        std::size_t slots = 0;
+    };
+
+    // The target works on 32-bit integers; anything outside is an error
+    // here rather than silently wrapping
+    const long long INT_MIN32 = -2147483648LL;
+    const long long INT_MAX32 = 2147483647LL;
+
+    // Guards against a miscompiled loop that never ends
+    const std::size_t MAX_STEPS = 100000000;
+
+    bool parseInt(const std::string& s, long long& v) {
+        if (s.empty()) return false;
+        char* end;
+        v = std::strtoll(s.c_str(), &end, 10);
+        return *end == '\0';
+    }
+
+    // Assemble `asmText`; false with a message in `error` on bad input
+    bool assemble(const std::string& asmText, Machine& m, std::string& error) {
+        struct Line {
+            Op op;
+            std::vector<std::string> args;
+        };
+        std::vector<Line> lines;
+        std::unordered_map<std::string, std::size_t> labels;
+        std::unordered_map<std::string, std::size_t> storage;
+
+        std::istringstream in(asmText);
+        for (std::string text; std::getline(in, text); ) {
+            std::istringstream words(text);
+            std::vector<std::string> w;
+            for (std::string s; words >> s; ) w.push_back(s);
+            if (w.empty()) continue;
+
+            if (w[0].size() > 1 && w[0].back() == ':') {
+                labels[w[0].substr(0, w[0].size() - 1)] = lines.size();
+                w.erase(w.begin());
+            }
+            auto op = w.empty() ? OPCODES.end() : OPCODES.find(w[0]);
+            long long init;
+            if (op == OPCODES.end()) {
+                if (w.size() == 2 && parseInt(w[1], init)) {   // storage directive
+                    storage[w[0]] = m.memory.size();
+                    m.memory.push_back(init);
+                    continue;
+                }
+                error = "cannot assemble '" + text + "'";
+                return false;
+            }
+            if (static_cast<int>(w.size()) - 1 != arity(op->second)) {
+                error = "wrong operand count in '" + text + "'";
+                return false;
+            }
+            lines.push_back(Line{op->second, std::vector<std::string>(w.begin() + 1, w.end())});
+        }
+        m.slots = m.memory.size();
+
+        for (const Line& l : lines) {
+            Instr ins{l.op, {}, {}};
+            Operand* ops[] = {&ins.a, &ins.b};
+            for (std::size_t i = 0; i < l.args.size(); ++i) {
+                const std::string& arg = l.args[i];
+                Operand& o = *ops[i];
+                if (isBranch(l.op)) {
+                    auto it = labels.find(arg);
+                    if (it == labels.end()) { error = "undefined label " + arg; return false; }
+                    o.index = it->second;
+                } else if (parseInt(arg, o.value)) {
+                    o.immediate = true;
+                } else {
+                    auto it = storage.find(arg);
+                    if (it == storage.end()) { error = "undefined storage " + arg; return false; }
+                    o.index = it->second;
+                }
+            }
+            m.code.push_back(ins);
+        }
+        return true;
+    }
+
+    // Run to STOP; returns the instruction count or 0 with `error` set
+    std::size_t run(Machine& m, const std::vector<long long>& input,
+                    std::vector<long long>& output, std::string& error) {
+        long long acc = 0;
+        std::size_t next = 0;
+        std::size_t pc = 0;
+        auto value = [&m](const Operand& o) { return o.immediate ? o.value : m.memory[o.index]; };
+        auto fits = [&error](long long v) {
+            if (v >= INT_MIN32 && v <= INT_MAX32) return true;
+            error = "32-bit overflow";
+            return false;
+        };
+
+        for (std::size_t steps = 1; steps <= MAX_STEPS; ++steps) {
+            if (pc >= m.code.size()) { error = "ran past the last instruction"; return 0; }
+            const Instr& ins = m.code[pc++];
+            switch (ins.op) {
+                case Op::ADD:  acc += value(ins.a); if (!fits(acc)) return 0; break;
+                case Op::SUB:  acc -= value(ins.a); if (!fits(acc)) return 0; break;
+                case Op::MULT: acc *= value(ins.a); if (!fits(acc)) return 0; break;
+                case Op::DIV:
+                    if (value(ins.a) == 0) { error = "division by zero"; return 0; }
+                    acc /= value(ins.a);
+                    if (!fits(acc)) return 0;
+                    break;
+                case Op::LOAD:  acc = value(ins.a); break;
+                case Op::STORE: m.memory[ins.a.index] = acc; break;
+                case Op::COPY:  m.memory[ins.a.index] = value(ins.b); break;
+                case Op::READ:
+                    if (next == input.size()) { error = "input exhausted"; return 0; }
+                    m.memory[ins.a.index] = input[next++];
+                    break;
+                case Op::WRITE: output.push_back(value(ins.a)); break;
+                case Op::BR:     pc = ins.a.index; break;
+                case Op::BRNEG:  if (acc < 0) pc = ins.a.index; break;
+                case Op::BRZNEG: if (acc <= 0) pc = ins.a.index; break;
+                case Op::BRPOS:  if (acc > 0) pc = ins.a.index; break;
+                case Op::BRZPOS: if (acc >= 0) pc = ins.a.index; break;
+                case Op::BRZERO: if (acc == 0) pc = ins.a.index; break;
+                case Op::NOOP: break;
+                case Op::STOP: return steps;
+            }
+        }
+        error = "no STOP within " + std::to_string(MAX_STEPS) + " instructions";
+        return 0;
+    }
+
+    // ---------- corpus ----------
+
+    struct Metrics {
+        std::size_t staticCount = 0;
+        std::size_t slots = 0;
+        std::size_t dynamic = 0;
+    };
+
+    std::string readFile(const std::string& path) {
+        std::ifstream f(path);
+        std::ostringstream s;
+        s << f.rdbuf();
+        return s.str();
+    }
+
+    std::vector<long long> readInts(const std::string& path) {
+        std::vector<long long> v;
+        std::ifstream f(path);
+        for (long long x; f >> x; ) v.push_back(x);
+        return v;
+    }
+
+    std::vector<std::string> corpus(const std::string& dir) {
+        std::vector<std::string> names;
+        DIR* d = ::opendir(dir.c_str());
+        if (!d) return names;
+        while (dirent* e = ::readdir(d)) {
+            std::string name = e->d_name;
+            std::size_t n = std::strlen(EXT);
+            if (name.size() > n && name.compare(name.size() - n, n, EXT) == 0)
+                names.push_back(name.substr(0, name.size() - n));
+        }
+        ::closedir(d);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    // Compile, assemble and run one program at one level; false with
+    // the reason in `error`
+    bool measure(const std::string& dir, const std::string& name, int level,
+                 const std::string& asmPath, Metrics& mx,
+                 std::vector<long long>& output, std::string& error) {
+        CompileOptions opts;
+        opts.passes = passesForLevel(level);
+        CompileContext cx(opts);
+        if (compilePaths(cx, dir + "/" + name + EXT, asmPath) != 0) {
+            error = "does not compile: " + cx.out.str() + cx.err.str();
+            return false;
+        }
+        Machine m;
+        if (!assemble(readFile(asmPath), m, error)) return false;
+        mx.staticCount = m.code.size();
+        mx.slots = m.slots;
+        mx.dynamic = run(m, readInts(dir + "/" + name + ".in"), output, error);
+        return mx.dynamic != 0;
+    }
+
+    using Key = std::pair<std::string, int>;   // program, -O level
+
+    std::map<Key, Metrics> readBaseline(const std::string& path) {
+        std::map<Key, Metrics> rows;
+        std::ifstream f(path);
+        for (std::string line; std::getline(f, line); ) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream w(line);
+            std::string name, level;
+            Metrics mx;
+            if (w >> name >> level >> mx.staticCount >> mx.slots >> mx.dynamic && level.size() == 2)
+                rows[Key{name, level[1] - '0'}] = mx;
+        }
+        return rows;
+    }
+
+    void writeBaseline(const std::string& path, const std::map<Key, Metrics>& rows) {
+        std::ofstream f(path);
+        f << "# make codequality baseline (make codequality-update rewrites it)\n"
+             "# program level static slots dynamic\n";
+        for (const auto& r : rows)
+            f << r.first.first << " O" << r.first.second << ' ' << r.second.staticCount << ' '
+              << r.second.slots << ' ' << r.second.dynamic << '\n';
+    }
+
+    // "123" or "123 (-4)" / "123 (+4)" against the baseline
+    std::string withDelta(std::size_t now, const Metrics* base, std::size_t Metrics::*field) {
+        std::string s = std::to_string(now);
+        if (!base || base->*field == now) return s;
+        long long d = static_cast<long long>(now) - static_cast<long long>(base->*field);
+        return s + " (" + (d > 0 ? "+" : "") + std::to_string(d) + ")";
+    }
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    std::string dir = "codequality";
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--dir=", 6) == 0) {
+            dir = argv[i] + 6;
+        } else if (std::strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else {
+            std::cerr << "Usage: codeQuality [--dir=<corpus>] [--update]\n";
+            return 1;
+        }
+    }
+
+    std::vector<std::string> names = corpus(dir);
+    if (names.empty()) {
+        std::cerr << "ERROR: no " << EXT << " programs in '" << dir << "'\n";
+        return 1;
+    }
+    char scratch[] = "/tmp/codeQualityXXXXXX";
+    if (!mkdtemp(scratch)) {
+        std::cerr << "ERROR: cannot create a scratch directory\n";
+        return 1;
+    }
+    const std::string asmPath = std::string(scratch) + "/prog.asm";
+
+    const std::string baselinePath = dir + "/" + BASELINE;
+    std::map<Key, Metrics> baseline = readBaseline(baselinePath);
+    std::map<Key, Metrics> current;
+    int failures = 0;
+
+    std::cout << std::left << std::setw(12) << "program" << std::setw(7) << "level"
+              << std::setw(16) << "static" << std::setw(16) << "slots" << "dynamic\n";
+    for (const std::string& name : names) {
+        const std::string outPath = dir + "/" + name + ".out";
+        std::vector<long long> expected = readInts(outPath);
+        bool haveExpected = std::ifstream(outPath).good();
+
+        for (int level : LEVELS) {
+            Metrics mx;
+            std::vector<long long> output;
+            std::string error;
+            if (!measure(dir, name, level, asmPath, mx, output, error)) {
+                std::cout << "FAIL " << name << " -O" << level << ": " << error << '\n';
+                ++failures;
+                continue;
+            }
+            if (!haveExpected && update && level == 0) {
+                std::ofstream out(outPath);
+                for (long long v : output) out << v << '\n';
+                expected = output;
+                haveExpected = true;
+            }
+            if (!haveExpected || output != expected) {
+                std::cout << "FAIL " << name << " -O" << level << ": output differs from "
+                          << outPath << '\n';
+                ++failures;
+                continue;
+            }
+
+            Key key{name, level};
+            current[key] = mx;
+            auto b = baseline.find(key);
+            const Metrics* base = b == baseline.end() ? nullptr : &b->second;
+            std::cout << std::setw(12) << name << std::setw(7) << ("-O" + std::to_string(level))
+                      << std::setw(16) << withDelta(mx.staticCount, base, &Metrics::staticCount)
+                      << std::setw(16) << withDelta(mx.slots, base, &Metrics::slots)
+                      << withDelta(mx.dynamic, base, &Metrics::dynamic) << '\n';
+            if (update) continue;
+            if (!base) {
+                std::cout << "FAIL " << name << " -O" << level << ": not in " << baselinePath << '\n';
+                ++failures;
+            } else if (mx.staticCount > base->staticCount || mx.slots > base->slots ||
+                       mx.dynamic > base->dynamic) {
+                std::cout << "FAIL " << name << " -O" << level << ": regressed against "
+                          << baselinePath << '\n';
+                ++failures;
+            }
+        }
+    }
+    std::remove(asmPath.c_str());
+    rmdir(scratch);
+
+    if (update) {
+        if (failures) {
+            std::cout << "baseline not updated: " << failures << " failure(s)\n";
+            return 1;
+        }
+        writeBaseline(baselinePath, current);
+        std::cout << "wrote " << baselinePath << '\n';
+        return 0;
+    }
+    if (failures) {
+        std::cout << failures << " failure(s)\n";
+        return 1;
+    }
+    std::cout << "no regressions\n";
+    return 0;
+}
@@ -0,0 +1,168 @@
+// compiler.cpp (one compilation, front to back)
+#include "compiler.h"
+#include "cache.h"
+#include "codeGen.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "source.h"
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <memory>
+
+static const char* EXT = ".fs25s2";
+
+std::string CompileOptions::outputKey() const {
+    std::string key = scope == ScopeMode::Local ? "scope=local" : "scope=global";
+    // streaming reports exactly what single-pass does
+    if (singlePass || stream) key += " single-pass";
+    if (passes) {
+        key += " passes=" + passNames(passes);
+        // passes see one statement at a time when streaming
+        if (stream) key += " stream";
+    }
+    return key;
+}
+
+static void reportPipeline(CompileContext& cx) {
+    PipelineStats ps = cx.scanner.pipelineStats();
+    cx.err << "pipeline: " << ps.batches << " batches of <= " << ps.batchTokens
+           << " tokens, ring capacity " << ps.capacity
+           << ", peak occupancy " << ps.peakOccupancy
+           << " (" << (100.0 * ps.peakOccupancy / ps.capacity) << "%)"
+           << ", mean " << ps.meanOccupancy
+           << ", producer stalls " << ps.producerStalls
+           << ", parser stalls " << ps.consumerStalls << '\n';
+}
+
+// Ends a compilation on every path out of compilePhases, errors
+// included: the scanner's producer thread (--pipeline) is stopped and
+// its input unmapped, and the tree is freed (the pool keeps its first
+// blocks for the next compile). A context reused by a server worker
+// would otherwise keep the thread and the input until its next compile.
+namespace {
+    struct EndOfCompile {
+        CompileContext& cx;
+        ~EndOfCompile() {
+            cx.scanner.close();
+            cx.nodes.release();
+        }
+    };
+} // end anonymous namespace
+
+static int compilePhases(CompileContext& cx, FILE* in, const std::string& outName) {
+    CompileStats& st = cx.stats;
+    EndOfCompile end{cx};
+    {
+        PhaseTimer t(st, "scan-init");
+        // scanner reads stdin if in == nullptr
+        cx.scanner.open(in, cx.symbols, cx.err, cx.opts.scanMode);
+    }
+
+    bool singlePass = cx.opts.singlePass || cx.opts.stream;
+    SemanticsPass sem(cx, cx.opts.scope);
+    StorageCollector storage;
+    std::unique_ptr<StatementGenerator> streamGen;
+    if (cx.opts.stream) streamGen = std::make_unique<StatementGenerator>(cx);
+
+    Node* root;
+    {
+        PhaseTimer t(st, "parse");
+        // P2: build parse tree (and, in single-pass mode, run P3 as it
+        // goes; streaming also generates each statement and drops it)
+        if (streamGen)
+            root = parser(cx, sem, storage, [&streamGen](Node* stat) { streamGen->statement(stat); });
+        else
+            root = singlePass ? parser(cx, sem, storage) : parser(cx);
+    }
+    st.tokens = cx.scanner.tokenCount();
+    st.nodes = cx.nodes.count();
+    st.symbols = static_cast<std::size_t>(cx.symbols.size());
+
+    if (cx.opts.pipelineStats) reportPipeline(cx);
+
+    {
+        PhaseTimer t(st, "semantics");
+        // P3: static semantics (errors stop here), sharing one traversal
+        // with codegen's storage scan
+        if (!singlePass) traverse(root, sem, storage);
+        sem.finish();
+    }
+
+    {
+        PhaseTimer t(st, "codegen");
+        // P4: codegen to output file
+        std::ofstream out(outName);
+        if (!out) {
+            cx.err << "ERROR: cannot open output file '" << outName << "'\n";
+            return 1;
+        }
+
+        if (streamGen)
+            streamGen->finish(out, storage);
+        else
+            generateTarget(cx, root, out, storage);
+        out.close();
+    }
+    if (cx.opts.passStats) reportPasses(cx);
+
+    return 0;
+}
+
+// stdin when inPath is nullptr
+static int compileStream(CompileContext& cx, const char* inPath, const std::string& outPath) {
+    cx.stats = CompileStats{};
+    std::unique_ptr<FILE, int (*)(FILE*)> in(nullptr, std::fclose);
+    if (inPath) {
+        in.reset(std::fopen(inPath, "r"));
+        if (!in) {
+            cx.err << "ERROR: cannot open input file '" << inPath << "'\n";
+            return 1;
+        }
+    }
+
+    // Cached results replay their messages; ring and pass statistics
+    // describe a real run, so --pipeline-stats and --pass-stats always
+    // compile
+    bool reports = cx.opts.pipelineStats || cx.opts.passStats;
+    CompileCache* cache = (inPath && !reports) ? cx.opts.cache : nullptr;
+    std::string key;
+    if (cache) {
+        PhaseTimer t(cx.stats, "cache-lookup");
+        SourceBuffer src;
+        if (src.load(in.get())) {
+            key = CompileCache::key(src.begin(), src.size, cx.opts.outputKey());
+            cx.stats.cached = cache->fetch(key, cx, outPath);
+        }
+        std::rewind(in.get());
+    }
+    if (cx.stats.cached) return 0;
+
+    try {
+        int status = compilePhases(cx, in.get(), outPath);
+        if (status == 0 && !key.empty()) cache->store(key, cx, outPath);
+        return status;
+    } catch (const CompileError&) {
+        // diagnostic already written
+    } catch (const std::exception& e) {
+        cx.err << "ERROR: internal compiler error: " << e.what() << '\n';
+    }
+    return 1;
+}
+
+int compileFile(CompileContext& cx, const char* base) {
+    if (!base) return compileStream(cx, nullptr, "a.asm");
+    std::string inName = std::string(base) + EXT;
+    return compileStream(cx, inName.c_str(), std::string(base) + ".asm");
+}
+
+int compilePaths(CompileContext& cx, const std::string& inPath, const std::string& outPath) {
+    return compileStream(cx, inPath.c_str(), outPath);
+}
+
+void CompileContext::reset() {
+    out.str("");
+    out.clear();
+    err.str("");
+    err.clear();
+}
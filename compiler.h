@@ -0,0 +1,70 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+#include <sstream>
+#include <string>
+#include "intern.h"
+#include "node.h"
+#include "scanner.h"
+#include "statSem.h"
+#include "stats.h"
+
+class CompileCache;
+
+// How to compile (set from the command line)
+struct CompileOptions {
+    ScanMode scanMode = ScanMode::Direct;
+    ScopeMode scope = ScopeMode::Global;
+    bool singlePass = false;
+    bool stream = false;          // one statement in memory at a time (implies singlePass)
+    bool pipelineStats = false;   // report ring occupancy on `err`
+    unsigned passes = 0;          // optimization passes to run (optimizer.h); none at -O0
+    bool passStats = false;       // report per-pass time and sizes on `err`
+    CompileCache* cache = nullptr;   // reuse earlier results (shared, thread-safe)
+
+    // The options that can change a compile's output or messages, as a
+    // stable string for cache keys
+    std::string outputKey() const;
+};
+
+
+// Thrown by a phase that has already written its diagnostic to the
+// context and cannot continue. compileFile() turns it into status 1;
+// it never leaves the compiler.
+struct CompileError {};
+
+
+// Everything one compilation owns. Phases take the context instead of
+// keeping file-scope state, and diagnostics are buffered in it rather
+// than printed, so any number of compilations can run side by side and
+// their output still comes out whole.
+struct CompileContext {
+    explicit CompileContext(const CompileOptions& opts = CompileOptions{}) : opts(opts) {}
+    CompileContext(const CompileContext&) = delete;
+    CompileContext& operator=(const CompileContext&) = delete;
+
+    // Drop the diagnostics of the previous compilation. Everything else
+    // is reset by the phases themselves, so one context can be reused
+    // for many compilations and keep its allocations warm.
+    void reset();
+
+    CompileOptions opts;
+    Interner symbols;
+    NodePool nodes;
+    Scanner scanner;
+
+    std::ostringstream out;   // what the compiler reports on stdout
+    std::ostringstream err;   // ... and on stderr
+    CompileStats stats;       // costs and counts of the last compilation
+};
+
+
+// Compile <base>.fs25s2 into <base>.asm, or stdin into a.asm when base
+// is nullptr. Returns the exit status (0 or 1); all messages, including
+// P3 warnings, are left in cx.out / cx.err and the costs in cx.stats.
+int compileFile(CompileContext& cx, const char* base);
+
+// Same, with explicit input and output paths
+int compilePaths(CompileContext& cx, const std::string& inPath, const std::string& outPath);
+
+
+#endif // COMPILER_H
@@ -0,0 +1,50 @@
+// intern.cpp
+#include "intern.h"
+#include <cstring>
+
+namespace {
+    std::uint64_t packName(std::string_view name) {
+        std::uint64_t key = 0;
+        std::memcpy(&key, name.data(), name.size() < 8 ? name.size() : 8);
+        return key;
+    }
+
+    std::size_t hashKey(std::uint64_t key) {
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+} // end anonymous namespace
+
+int Interner::intern(std::string_view name) {
+    if (2 * (names.size() + 1) > slots.size()) grow();
+
+    std::uint64_t key = packName(name);
+    std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hashKey(key) & mask; ; i = (i + 1) & mask) {
+        Slot& s = slots[i];
+        if (s.id < 0) {
+            s = Slot{key, static_cast<int>(names.size())};
+            names.emplace_back(name);
+            return s.id;
+        }
+        if (s.key == key) return s.id;
+    }
+}
+
+void Interner::grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(old.empty() ? 64 : old.size() * 2, Slot{0, -1});
+
+    std::size_t mask = slots.size() - 1;
+    for (const Slot& s : old) {
+        if (s.id < 0) continue;
+        std::size_t i = hashKey(s.key) & mask;
+        while (slots[i].id >= 0) i = (i + 1) & mask;
+        slots[i] = s;
+    }
+}
+
+void Interner::clear() {
+    if (!names.empty()) slots.assign(slots.size(), Slot{0, -1});
+    names.clear();
+}
@@ -0,0 +1,35 @@
+#ifndef INTERN_H
+#define INTERN_H
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "token.h"
+
+
+// Maps identifier spellings to dense symbol IDs 0, 1, 2, ... in the
+// order they are first seen. Identifiers are at most 8 characters, so
+// a spelling is keyed by its zero-padded 8 bytes and no strings are
+// ever allocated. The keys live in an open-addressing table that
+// clear() empties without freeing, so a scanner reopened on the same
+// interner (batch, server, --bench-lex) allocates nothing per token.
+class Interner {
+public:
+    int intern(std::string_view name);
+    std::string_view name(int id) const { return names[static_cast<std::size_t>(id)].view(); }
+    int size() const { return static_cast<int>(names.size()); }
+    void clear();
+
+private:
+    struct Slot {
+        std::uint64_t key;
+        int id;                 // -1 when empty
+    };
+
+    void grow();
+
+    std::vector<Slot> slots;    // power-of-two size, at most half full
+    std::vector<Lexeme> names;
+};
+
+
+#endif // INTERN_H
@@ -0,0 +1,232 @@
+// ir.cpp (IR tables, basic blocks, instruction selection and text)
+#include "ir.h"
+#include <cstdint>
+
+// ---------- unit tables ----------
+
+IrOperand IrUnit::addConst(int value, const Lexeme& spelling) {
+    constants.push_back(IrConst{value, spelling});
+    return IrOperand::constant(static_cast<int>(constants.size() - 1));
+}
+
+int IrUnit::addLabel(IrLabelKind kind, int number) {
+    labels.push_back(IrLabel{kind, number});
+    return static_cast<int>(labels.size() - 1);
+}
+
+IrOperand IrUnit::useVar(int sym, const Lexeme& spelling) {
+    std::size_t i = static_cast<std::size_t>(sym);
+    if (i >= names.size()) names.resize(i + 1);
+    names[i] = spelling;
+    return IrOperand::var(sym);
+}
+
+void IrUnit::clearCode() {
+    code.clear();
+    target.clear();
+    constants.clear();
+    labels.clear();
+    tempBase = tempCount;
+}
+
+// ---------- basic blocks ----------
+
+static bool endsBlock(IrOp op) {
+    return op == IrOp::Jump || op == IrOp::JumpIf;
+}
+
+// Blocks of any instruction list, given where labels are defined and
+// jumped to (label index or -1) and which instructions never fall through
+template <class Instr, class LabelAt, class JumpTo, class Falls>
+static std::vector<IrBlock> blocksOf(const std::vector<Instr>& code, std::size_t labels,
+                                     LabelAt labelAt, JumpTo jumpTo, Falls fallsThrough) {
+    std::vector<IrBlock> blocks;
+    std::vector<std::size_t> blockOfLabel(labels, SIZE_MAX);
+
+    for (std::size_t i = 0; i < code.size(); ++i) {
+        bool leader = i == 0 || labelAt(code[i]) >= 0 || jumpTo(code[i - 1]) >= 0;
+        if (leader) blocks.push_back(IrBlock{i, i, {}});
+        blocks.back().end = i + 1;
+        if (labelAt(code[i]) >= 0)
+            blockOfLabel[static_cast<std::size_t>(labelAt(code[i]))] = blocks.size() - 1;
+    }
+
+    for (std::size_t b = 0; b < blocks.size(); ++b) {
+        const Instr& last = code[blocks[b].end - 1];
+        if (fallsThrough(last) && b + 1 < blocks.size()) blocks[b].succs.push_back(b + 1);
+        if (jumpTo(last) >= 0) {
+            std::size_t to = blockOfLabel[static_cast<std::size_t>(jumpTo(last))];
+            // a label outside the unit (or at its end) leaves it
+            if (to != SIZE_MAX && (blocks[b].succs.empty() || blocks[b].succs[0] != to))
+                blocks[b].succs.push_back(to);
+        }
+    }
+    return blocks;
+}
+
+std::vector<IrBlock> basicBlocks(const IrUnit& u) {
+    return blocksOf(u.code, u.labels.size(),
+        [](const IrInstr& i) { return i.op == IrOp::Label ? i.label : -1; },
+        [](const IrInstr& i) { return endsBlock(i.op) ? i.label : -1; },
+        [](const IrInstr& i) { return i.op != IrOp::Jump; });
+}
+
+std::vector<IrBlock> targetBlocks(const IrUnit& u) {
+    return blocksOf(u.target, u.labels.size(),
+        [](const AsmInstr& i) { return i.label; },
+        [](const AsmInstr& i) { return i.target; },
+        [](const AsmInstr& i) { return i.op != AsmOp::BR; });
+}
+
+// ---------- instruction selection ----------
+
+// Assembly instructions for one IR instruction (see selectTarget)
+static std::size_t selectedSize(const IrInstr& ins) {
+    switch (ins.op) {
+        case IrOp::Copy: return 2;
+        case IrOp::Add:
+        case IrOp::Sub:
+        case IrOp::Mul:
+        case IrOp::Div: return 3;
+        case IrOp::Read:
+        case IrOp::Write:
+        case IrOp::Label:
+        case IrOp::Jump: return 1;
+        case IrOp::JumpIf:
+            return (ins.rel == IrRel::Le || ins.rel == IrRel::Ge || ins.rel == IrRel::Ne) ? 4 : 3;
+    }
+    return 0;
+}
+
+std::size_t targetSize(const IrUnit& u) {
+    std::size_t n = 0;
+    for (const IrInstr& ins : u.code) n += selectedSize(ins);
+    return n;
+}
+
+void selectTarget(IrUnit& u) {
+    std::vector<AsmInstr>& out = u.target;
+    out.clear();
+    out.reserve(targetSize(u));
+    auto put = [&out](AsmOp op, IrOperand arg) { out.push_back(AsmInstr{op, arg, -1, -1}); };
+    auto branch = [&out](AsmOp op, int label) { out.push_back(AsmInstr{op, IrOperand{}, -1, label}); };
+
+    for (const IrInstr& ins : u.code) {
+        switch (ins.op) {
+            case IrOp::Copy:
+                put(AsmOp::LOAD, ins.a);
+                put(AsmOp::STORE, ins.dst);
+                break;
+            case IrOp::Add:
+            case IrOp::Sub:
+            case IrOp::Mul:
+            case IrOp::Div: {
+                AsmOp op = ins.op == IrOp::Add ? AsmOp::ADD
+                         : ins.op == IrOp::Sub ? AsmOp::SUB
+                         : ins.op == IrOp::Mul ? AsmOp::MULT : AsmOp::DIV;
+                put(AsmOp::LOAD, ins.a);
+                put(op, ins.b);
+                put(AsmOp::STORE, ins.dst);
+                break;
+            }
+            case IrOp::Read:
+                put(AsmOp::READ, ins.dst);
+                break;
+            case IrOp::Write:
+                put(AsmOp::WRITE, ins.a);
+                break;
+            case IrOp::Label:
+                out.push_back(AsmInstr{AsmOp::NOOP, IrOperand{}, ins.label, -1});
+                break;
+            case IrOp::Jump:
+                branch(AsmOp::BR, ins.label);
+                break;
+            case IrOp::JumpIf:
+                // on a - b; two-branch forms keep the original code shape
+                put(AsmOp::LOAD, ins.a);
+                put(AsmOp::SUB, ins.b);
+                switch (ins.rel) {
+                    case IrRel::Lt: branch(AsmOp::BRNEG, ins.label); break;
+                    case IrRel::Le: branch(AsmOp::BRNEG, ins.label);
+                                    branch(AsmOp::BRZERO, ins.label); break;
+                    case IrRel::Gt: branch(AsmOp::BRPOS, ins.label); break;
+                    case IrRel::Ge: branch(AsmOp::BRPOS, ins.label);
+                                    branch(AsmOp::BRZERO, ins.label); break;
+                    case IrRel::Eq: branch(AsmOp::BRZERO, ins.label); break;
+                    case IrRel::Ne: branch(AsmOp::BRNEG, ins.label);
+                                    branch(AsmOp::BRPOS, ins.label); break;
+                }
+                break;
+        }
+    }
+}
+
+// ---------- text ----------
+
+static const char* opName(AsmOp op) {
+    switch (op) {
+        case AsmOp::ADD:    return "ADD";
+        case AsmOp::BR:     return "BR";
+        case AsmOp::BRNEG:  return "BRNEG";
+        case AsmOp::BRPOS:  return "BRPOS";
+        case AsmOp::BRZERO: return "BRZERO";
+        case AsmOp::BRZNEG: return "BRZNEG";
+        case AsmOp::BRZPOS: return "BRZPOS";
+        case AsmOp::DIV:    return "DIV";
+        case AsmOp::LOAD:   return "LOAD";
+        case AsmOp::MULT:   return "MULT";
+        case AsmOp::NOOP:   return "NOOP";
+        case AsmOp::READ:   return "READ";
+        case AsmOp::STORE:  return "STORE";
+        case AsmOp::SUB:    return "SUB";
+        case AsmOp::WRITE:  return "WRITE";
+    }
+    return "?";
+}
+
+static void writeLabel(const IrUnit& u, int label, std::ostream& out) {
+    const IrLabel& l = u.labels[static_cast<std::size_t>(label)];
+    switch (l.kind) {
+        case IrLabelKind::While:    out << "WHILE"; break;
+        case IrLabelKind::EndWhile: out << "ENDWHILE"; break;
+        case IrLabelKind::EndIf:    out << "ENDIF"; break;
+    }
+    out << l.number;
+}
+
+static void writeOperand(const IrUnit& u, const IrOperand& o, std::ostream& out) {
+    switch (o.kind) {
+        case IrOperand::Kind::Var:
+            out << u.names[static_cast<std::size_t>(o.id)];
+            break;
+        case IrOperand::Kind::Temp:
+            out << "_t" << o.id;
+            break;
+        case IrOperand::Kind::Const: {
+            const IrConst& c = u.constants[static_cast<std::size_t>(o.id)];
+            if (c.spelling.empty()) out << c.value;
+            else out << c.spelling;
+            break;
+        }
+        case IrOperand::Kind::None:
+            break;
+    }
+}
+
+void writeTarget(const IrUnit& u, std::ostream& out) {
+    for (const AsmInstr& ins : u.target) {
+        if (ins.label >= 0) {
+            writeLabel(u, ins.label, out);
+            out << ": ";
+        }
+        out << opName(ins.op);
+        if (ins.target >= 0) {
+            out << ' ';
+            writeLabel(u, ins.target, out);
+        } else if (ins.arg.kind != IrOperand::Kind::None) {
+            out << ' ';
+            writeOperand(u, ins.arg, out);
+        }
+        out << '\n';
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef IR_H
+#define IR_H
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "token.h"
+
+
+// Three-address intermediate code between the parse tree and the
+// accumulator assembly. Code generation lowers statements to IrInstr;
+// instruction selection turns those into a typed assembly list
+// (AsmInstr), and only writeTarget() produces text. Optimization passes
+// (optimizer.h) rewrite either list.
+
+// ---------- operands ----------
+
+// A program variable (interned symbol ID), a temporary (_t<id>), or a
+// constant (index into IrUnit::constants)
+struct IrOperand {
+    enum class Kind : std::uint8_t { None, Var, Temp, Const };
+
+    Kind kind = Kind::None;
+    int id = 0;
+
+    static IrOperand var(int sym)    { return IrOperand{Kind::Var, sym}; }
+    static IrOperand temp(int n)     { return IrOperand{Kind::Temp, n}; }
+    static IrOperand constant(int i) { return IrOperand{Kind::Const, i}; }
+
+    bool isTemp() const { return kind == Kind::Temp; }
+    bool operator==(const IrOperand& o) const { return kind == o.kind && id == o.id; }
+    bool operator!=(const IrOperand& o) const { return !(*this == o); }
+};
+
+// An integer literal. Literals from the source keep their spelling
+// (leading zeros included) so unoptimized output is unchanged; an empty
+// spelling prints the value.
+struct IrConst {
+    int value;
+    Lexeme spelling;
+};
+
+// Labels print as <kind><number>, numbered across the whole program
+enum class IrLabelKind : std::uint8_t { While, EndWhile, EndIf };
+
+struct IrLabel {
+    IrLabelKind kind;
+    int number;
+};
+
+// ---------- three-address code ----------
+
+enum class IrOp : std::uint8_t {
+    Copy,       // dst = a
+    Add,        // dst = a + b
+    Sub,        // dst = a - b
+    Mul,        // dst = a * b
+    Div,        // dst = a / b (truncating)
+    Read,       // dst = next input
+    Write,      // output a
+    Label,      // label:
+    Jump,       // goto label
+    JumpIf      // if (a rel b) goto label
+};
+
+enum class IrRel : std::uint8_t { Lt, Le, Gt, Ge, Eq, Ne };
+
+struct IrInstr {
+    IrOp op;
+    IrRel rel = IrRel::Eq;   // JumpIf only
+    IrOperand dst;
+    IrOperand a;
+    IrOperand b;
+    int label = -1;          // Label, Jump, JumpIf: index into IrUnit::labels
+};
+
+// ---------- typed assembly ----------
+
+enum class AsmOp : std::uint8_t {
+    ADD, BR, BRNEG, BRPOS, BRZERO, BRZNEG, BRZPOS, DIV, LOAD, MULT,
+    NOOP, READ, STORE, SUB, WRITE
+};
+
+struct AsmInstr {
+    AsmOp op;
+    IrOperand arg;           // data operand, if any
+    int label = -1;          // label defined on this line (a "L: NOOP"), or -1
+    int target = -1;         // branch target label, or -1
+};
+
+// ---------- a unit of code ----------
+
+// The code of a program (or, when streaming, of one top-level
+// statement) with the tables its operands refer to
+struct IrUnit {
+    std::vector<IrInstr> code;
+    std::vector<AsmInstr> target;           // filled by selectTarget()
+    std::vector<IrConst> constants;
+    std::vector<IrLabel> labels;
+    // spelling of each variable used so far, by symbol ID, copied so
+    // writing the code reads neither the tree (released statement by
+    // statement when streaming) nor the interner (which a pipelined
+    // scanner may still be filling)
+    std::vector<Lexeme> names;
+    int tempCount = 0;                      // temps are _t0.._t<tempCount-1>
+    int tempBase = 0;                       // tempCount when `code` was started
+
+    IrOperand addConst(int value, const Lexeme& spelling = Lexeme());
+    int addLabel(IrLabelKind kind, int number);
+    IrOperand useVar(int sym, const Lexeme& spelling);
+
+    // Drop the code and its constants and labels; names and tempCount
+    // carry over to the next statement. No temp is live across
+    // statements, so passes may give the next one's temps the slots
+    // below tempBase again.
+    void clearCode();
+};
+
+// ---------- basic blocks ----------
+
+// A maximal straight-line run of IR: control enters only at `begin`
+// (a label or the instruction after a jump) and leaves only after
+// `end - 1`
+struct IrBlock {
+    std::size_t begin;
+    std::size_t end;
+    std::vector<std::size_t> succs;   // indices of successor blocks
+};
+
+// The control-flow graph of u.code, blocks in code order. The last
+// block's fall-through (and any jump to a label at the very end) leaves
+// the unit.
+std::vector<IrBlock> basicBlocks(const IrUnit& u);
+
+// The same over the selected assembly, u.target
+std::vector<IrBlock> targetBlocks(const IrUnit& u);
+
+// ---------- emission ----------
+
+// Instruction selection: u.code into u.target
+void selectTarget(IrUnit& u);
+
+// Number of assembly instructions selectTarget() will produce
+std::size_t targetSize(const IrUnit& u);
+
+// Write u.target as assembly text, one instruction per line
+void writeTarget(const IrUnit& u, std::ostream& out);
+
+
+#endif // IR_H
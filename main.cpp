@@ -1,58 +1,189 @@
 // main.cpp (P4: compile)
-#include <cstdio>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "batch.h"
+#include "cache.h"
+#include "compiler.h"
+#include "optimizer.h"
 #include "scanner.h"
-#include "parser.h"
-#include "statSem.h"
-#include "codeGen.h"
+#include "server.h"
 
-static const char* EXT = ".fs25s2";
-
-int main(int argc, char** argv) {
-    if (argc > 2) {
-        std::cerr << "Usage: compile [file]\n";
-        return 1;
+// "64M" and the like; false on a malformed size
+static bool parseSize(const char* s, std::uint64_t& bytes) {
+    char* end;
+    unsigned long long n = std::strtoull(s, &end, 10);
+    if (end == s) return false;
+    switch (*end) {
+        case 'K': n <<= 10; ++end; break;
+        case 'M': n <<= 20; ++end; break;
+        case 'G': n <<= 30; ++end; break;
+        default: break;
     }
+    if (*end) return false;
+    bytes = n;
+    return true;
+}
 
-    FILE* in = nullptr;
-    std::string baseName;
-    std::string outName = "a.asm";
+static int usage() {
+    std::cerr << "Usage: compile [--parallel-lex | --pipeline | --pipeline-stats] [--scope=global | --scope=local] [--single-pass | --stream] [--jobs=N]\n"
+                 "               [--cache=<dir> [--cache-size=N[K|M|G]] [--cache-stats]]\n"
+                 "               [-O0 | -O1 | -O2] [-f<pass> | -fno-<pass>]... [--pass-stats]\n"
+                 "               [--stats[=<file>]] [--bench-lex] [file...]\n"
+                 "       compile --serve=<socket> [options]\n"
+                 "       compile --client=<socket> (file... | --server-stats | --server-stop)\n"
+                 "Passes:\n";
+    for (const PassInfo& p : passRegistry())
+        std::cerr << "  " << p.name << " (-O" << p.level << "): " << p.summary << '\n';
+    return 1;
+}
 
-    if (argc == 2) {
-        baseName = argv[1];
-        std::string inName = baseName + EXT;
+int main(int argc, char** argv) {
+    CompileOptions opts;
+    bool benchLex = false;
+    unsigned jobs = 0;
+    const char* serveSocket = nullptr;
+    const char* clientSocket = nullptr;
+    bool serverStats = false;
+    bool serverStop = false;
+    const char* cacheDir = nullptr;
+    std::uint64_t cacheLimit = 256ull << 20;
+    bool cacheStats = false;
+    bool stats = false;
+    const char* statsFile = nullptr;   // stderr when not given
+    int optLevel = 0;
+    std::vector<std::pair<int, bool>> passFlags;   // -f / -fno- in order
+    std::vector<const char*> files;
 
-        in = std::fopen(inName.c_str(), "r");
-        if (!in) {
-            std::cerr << "ERROR: cannot open input file '" << inName << "'\n";
-            return 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--parallel-lex") == 0) {
+            opts.scanMode = ScanMode::Parallel;
+        } else if (std::strcmp(argv[i], "--pipeline") == 0) {
+            opts.scanMode = ScanMode::Pipelined;
+        } else if (std::strcmp(argv[i], "--pipeline-stats") == 0) {
+            opts.scanMode = ScanMode::Pipelined;
+            opts.pipelineStats = true;
+        } else if (std::strcmp(argv[i], "--scope=global") == 0) {
+            opts.scope = ScopeMode::Global;
+        } else if (std::strcmp(argv[i], "--scope=local") == 0) {
+            opts.scope = ScopeMode::Local;
+        } else if (std::strcmp(argv[i], "--single-pass") == 0) {
+            opts.singlePass = true;
+        } else if (std::strcmp(argv[i], "--stream") == 0) {
+            opts.stream = true;
+        } else if (std::strncmp(argv[i], "--jobs=", 7) == 0) {
+            char* end;
+            long n = std::strtol(argv[i] + 7, &end, 10);
+            if (*end || n < 1) return usage();
+            jobs = static_cast<unsigned>(n);
+        } else if (std::strncmp(argv[i], "--serve=", 8) == 0) {
+            serveSocket = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--client=", 9) == 0) {
+            clientSocket = argv[i] + 9;
+        } else if (std::strcmp(argv[i], "--server-stats") == 0) {
+            serverStats = true;
+        } else if (std::strcmp(argv[i], "--server-stop") == 0) {
+            serverStop = true;
+        } else if (std::strncmp(argv[i], "--cache=", 8) == 0) {
+            cacheDir = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--cache-size=", 13) == 0) {
+            if (!parseSize(argv[i] + 13, cacheLimit)) return usage();
+        } else if (std::strcmp(argv[i], "--cache-stats") == 0) {
+            cacheStats = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (std::strncmp(argv[i], "--stats=", 8) == 0) {
+            stats = true;
+            statsFile = argv[i] + 8;
+        } else if (std::strcmp(argv[i], "-O0") == 0 || std::strcmp(argv[i], "-O1") == 0 ||
+                   std::strcmp(argv[i], "-O2") == 0) {
+            optLevel = argv[i][2] - '0';
+        } else if (std::strncmp(argv[i], "-f", 2) == 0) {
+            bool on = std::strncmp(argv[i], "-fno-", 5) != 0;
+            int pass = findPass(argv[i] + (on ? 2 : 5));
+            if (pass < 0) return usage();
+            passFlags.push_back({pass, on});
+        } else if (std::strcmp(argv[i], "--pass-stats") == 0) {
+            opts.passStats = true;
+        } else if (std::strcmp(argv[i], "--bench-lex") == 0) {
+            benchLex = true;
+        } else if (argv[i][0] == '-') {
+            return usage();
+        } else {
+            files.push_back(argv[i]);
         }
+    }
 
-        outName = baseName + ".asm";
+    // -f flags override the level, whatever their position
+    opts.passes = passesForLevel(optLevel);
+    for (const auto& f : passFlags) {
+        if (f.second) opts.passes |= 1u << f.first;
+        else opts.passes &= ~(1u << f.first);
     }
 
-    // scanner reads stdin if in == nullptr
-    initScanner(in);
+    if (benchLex) {
+        if (files.size() > 1) return usage();
+        return testScanner(files.empty() ? nullptr : files[0], opts.scanMode);
+    }
 
-    // P2: build parse tree
-    Node* root = parser();
+    std::unique_ptr<CompileCache> cache;
+    if (cacheDir) {
+        cache = std::make_unique<CompileCache>(cacheDir, cacheLimit);
+        if (!cache->open()) return 1;
+        opts.cache = cache.get();
+    }
 
-    // P3: static semantics (must print to stdout and exit on error)
-    staticSemantics(root);
+    if (serveSocket) {
+        if (!files.empty() || clientSocket) return usage();
+        return serve(serveSocket, opts, jobs);
+    }
+    if (clientSocket) {
+        if (serverStats) return clientStats(clientSocket);
+        if (serverStop) return clientStop(clientSocket);
+        if (files.empty()) return usage();
+        int status = 0;
+        for (const char* f : files)
+            if (clientCompile(clientSocket, f)) status = 1;
+        return status;
+    }
+    if (serverStats || serverStop) return usage();
 
-    // P4: codegen to output file
-    std::ofstream out(outName);
-    if (!out) {
-        std::cerr << "ERROR: cannot open output file '" << outName << "'\n";
-        return 1;
+    std::ofstream statsOut;
+    std::ostream* statsTo = nullptr;
+    if (stats) {
+        statsTo = &std::cerr;
+        if (statsFile) {
+            statsOut.open(statsFile);
+            if (!statsOut) {
+                std::cerr << "ERROR: cannot open stats file '" << statsFile << "'\n";
+                return 1;
+            }
+            statsTo = &statsOut;
+        }
     }
 
-    generateTarget(root, out);
-    out.close();
+    int status;
+    if (files.size() > 1) {
+        // several programs: compile them side by side
+        status = compileBatch(files, opts, jobs, statsTo);
+    } else {
+        CompileContext cx(opts);
+        const char* file = files.empty() ? nullptr : files[0];
+        status = compileFile(cx, file);
+        std::cout << cx.out.str();
+        std::cerr << cx.err.str();
+        if (statsTo)
+            writeStatsJson(*statsTo, cx.stats,
+                           file ? (std::string(file) + ".fs25s2").c_str() : "stdin", status);
+    }
 
-    return 0;
+    if (cacheStats && cache) std::cerr << cache->stats();
+    return status;
 }
@@ -1,12 +1,39 @@
 #include "node.h"
+#include <new>
+#include <type_traits>
 
-Node* createNode(NodeType t) {
-    Node* n = new Node{
-        t,
-        Token{TokenID::ERR_tk, "", 0},
-        Token{TokenID::ERR_tk, "", 0},
-        Token{TokenID::ERR_tk, "", 0},
-        nullptr, nullptr, nullptr, nullptr
-    };
+static_assert(std::is_trivially_destructible<Node>::value &&
+              std::is_trivially_destructible<Token>::value,
+              "arena nodes are released without running destructors");
+static_assert(sizeof(Node) == alignof(Node) && alignof(Token) <= alignof(Node*),
+              "child pointers and tokens follow the label without padding");
+static_assert(sizeof(NODE_SHAPES) / sizeof(NODE_SHAPES[0]) ==
+              static_cast<std::size_t>(NodeType::R) + 1,
+              "a shape for every node type");
+
+const Token NO_TOKEN{TokenID::ERR_tk, TokenKind::ERR_tk, "", 0};
+
+void Node::clear() {
+    NodeShape s = shapeOf(label);
+    for (int i = 0; i < s.children; ++i) children()[i] = nullptr;
+    for (int i = 0; i < s.tokens; ++i) new (tokens() + i) Token(NO_TOKEN);
+}
+
+void Node::copySlots(const Node& from) {
+    NodeShape s = shapeOf(label);
+    for (int i = 0; i < s.children; ++i) children()[i] = from.children()[i];
+    for (int i = 0; i < s.tokens; ++i) tokens()[i] = from.tokens()[i];
+}
+
+Node* NodePool::create(NodeType t) {
+    void* mem = arena.allocate(sizeOf(t), alignof(Node));
+    ++created;
+    Node* n = new (mem) Node(t);
+    n->clear();
     return n;
 }
+
+void NodePool::release() {
+    arena.reset(KEEP_BYTES);
+    created = 0;
+}
@@ -1,9 +1,12 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <cstddef>
+#include <cstdint>
+#include "arena.h"
 #include "token.h"
 
-enum class NodeType {
+enum class NodeType : std::uint8_t {
     PROGRAM,
     VARS,
     VARLIST,
@@ -23,20 +26,118 @@ enum class NodeType {
     R
 };
 
-struct Node {
+// Token and child slots a node of each type has. No production needs
+// more than 3 of either, and the nodes that dominate a tree (operator
+// chains, statement lists) need one or two.
+struct NodeShape {
+    std::uint8_t tokens;
+    std::uint8_t children;
+};
+
+inline constexpr NodeShape NODE_SHAPES[] = {
+    {2, 2},   // PROGRAM: start trats; vars block
+    {3, 1},   // VARS:    var identifier integer; varList
+    {2, 1},   // VARLIST: identifier integer; next
+    {2, 2},   // BLOCK:   { }; vars stats
+    {0, 2},   // STATS:   stat mStat
+    {0, 2},   // MSTAT:   stat next
+    {0, 1},   // STAT:    the statement
+    {2, 0},   // READ:    read identifier
+    {1, 1},   // PRINT:   print; exp
+    {2, 3},   // COND:    if identifier; relational exp stat
+    {2, 3},   // LOOP:    while identifier; relational exp stat
+    {2, 1},   // ASSIGN:  set identifier; exp
+    {1, 0},   // REL:     operator
+    {1, 2},   // EXP:     + or -; M exp
+    {1, 2},   // M:       *; N M
+    {2, 2},   // N:       unary - and %; operands
+    {2, 1},   // R:       ( ) or identifier or integer; exp
+};
+
+inline constexpr NodeShape shapeOf(NodeType t) {
+    return NODE_SHAPES[static_cast<std::size_t>(t)];
+}
+
+// What reading a token slot the node does not have (or has not filled) gives
+extern const Token NO_TOKEN;
+
+// A node is its label followed, in the same arena allocation, by just
+// the slots its type has: first the child pointers, then the tokens.
+// An operator node takes 48 bytes where three inline tokens and three
+// children took 88. Slots are read by name; one the type lacks reads
+// as nullptr or NO_TOKEN. Writes go through childSlot()/tokenSlot(),
+// and the type must have the slot.
+struct alignas(alignof(void*)) Node {
     NodeType label;
 
-    // store up to 3 tokens per node (ID, keyword, op, int, etc.)
-    Token tk1;
-    Token tk2;
-    Token tk3;
+    Node* child1() const { return child(0); }
+    Node* child2() const { return child(1); }
+    Node* child3() const { return child(2); }
+
+    const Token& tk1() const { return token(0); }
+    const Token& tk2() const { return token(1); }
+    const Token& tk3() const { return token(2); }
+
+    // Slot i (1-based) for writing
+    Node*& childSlot(int i) { return children()[i - 1]; }
+    Token& tokenSlot(int i) { return tokens()[i - 1]; }
+
+    // Empty every slot
+    void clear();
+
+    // Give this node the slots of `from`, which has the same label
+    void copySlots(const Node& from);
 
-    Node* child1;
-    Node* child2;
-    Node* child3;
-    Node* child4;
+    Node(const Node&) = delete;
+    Node& operator=(const Node&) = delete;
+
+private:
+    friend class NodePool;
+    explicit Node(NodeType t) : label(t) {}
+
+    Node* child(int i) const {
+        return i < shapeOf(label).children ? children()[i] : nullptr;
+    }
+    const Token& token(int i) const {
+        return i < shapeOf(label).tokens ? tokens()[i] : NO_TOKEN;
+    }
+
+    Node** children() { return reinterpret_cast<Node**>(this + 1); }
+    Node* const* children() const { return reinterpret_cast<Node* const*>(this + 1); }
+    Token* tokens() { return reinterpret_cast<Token*>(children() + shapeOf(label).children); }
+    const Token* tokens() const {
+        return reinterpret_cast<const Token*>(children() + shapeOf(label).children);
+    }
 };
 
-Node* createNode(NodeType t);
+// The nodes of one compilation, carved from an arena and freed together
+class NodePool {
+public:
+    // Allocate a node with empty slots
+    Node* create(NodeType t);
+
+    // Free every node created so far in one call. Up to KEEP_BYTES of
+    // arena blocks stay allocated for the next compilation on this pool.
+    void release();
+    static const std::size_t KEEP_BYTES = 4 << 20;
+
+    // Free only the nodes created after mark() (streaming mode drops each
+    // statement this way); count() still includes them
+    Arena::Mark mark() const { return arena.mark(); }
+    void releaseTo(Arena::Mark m) { arena.rewind(m); }
+
+    // Nodes created since the last release(), and heap bytes held for them
+    std::size_t count() const { return created; }
+    std::size_t bytes() const { return arena.reserved(); }
+
+    // Bytes a node of type t takes
+    static std::size_t sizeOf(NodeType t) {
+        return sizeof(Node) + shapeOf(t).children * sizeof(Node*) + shapeOf(t).tokens * sizeof(Token);
+    }
+
+private:
+    Arena arena;
+    std::size_t created = 0;
+};
 
 #endif // NODE_H
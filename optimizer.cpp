@@ -0,0 +1,966 @@
+// optimizer.cpp (pass manager and the optimization passes)
+#include "optimizer.h"
+#include "compiler.h"
+#include "ir.h"
+#include "visitor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+
+namespace {
+    // ---------- fold-constants ----------
+
+    // Constant expressions are evaluated with the target's arithmetic:
+    // 32-bit values, each operation checked for overflow (the machine
+    // traps on it), division truncating, and a % b computed as
+    // a - (a / b) * b the way the generated code does. An operation
+    // that would overflow or divide by zero is left for run time.
+    // Annihilators (x * 0, x % 1) drop x unless it may divide by zero;
+    // an overflow inside x is not kept, as compilers generally do.
+
+    const long long INT_LIMIT = 2147483647LL;
+
+    // Folded values become NUM leaves, whose spelling holds 8 digits
+    const int MAX_LITERAL = 99999999;
+
+    bool checked(long long v, int& out) {
+        if (v > INT_LIMIT || v < -INT_LIMIT - 1) return false;
+        out = static_cast<int>(v);
+        return true;
+    }
+
+    bool modulo(int a, int b, int& out) {
+        if (b == 0 || (a == -INT_LIMIT - 1 && b == -1)) return false;
+        int q = a / b, prod;
+        return checked(static_cast<long long>(q) * b, prod) &&
+               checked(static_cast<long long>(a) - prod, out);
+    }
+
+    // What folding learned about a subexpression
+    struct Folded {
+        bool known = false;     // its value is `value`
+        int value = 0;
+        bool mayTrap = false;   // it divides by something not known to be nonzero
+    };
+
+    Folded constant(int v) { return Folded{true, v, false}; }
+
+    Folded unknown(bool mayTrap) { return Folded{false, 0, mayTrap}; }
+
+    bool isConst(const Folded& f, int v) { return f.known && f.value == v; }
+
+
+    // Rewrites EXP/M/N/R subtrees bottom-up. Operator chains are
+    // right spines (see the parser), walked with explicit stacks as
+    // code generation does, parentheses included.
+    class ConstantFolder : public TreePass {
+    public:
+        explicit ConstantFolder(NodePool& pool) : pool(pool) {}
+
+        // Expressions hang off these statements; inner nodes are left
+        // to the folding started here
+        using TreePass::visit;
+        void visit(NodeTag<NodeType::PRINT>, Node* n, int)  { exp(n->child1()); }
+        void visit(NodeTag<NodeType::ASSIGN>, Node* n, int) { exp(n->child2() ? n->child2() : n->child1()); }
+        void visit(NodeTag<NodeType::COND>, Node* n, int)   { exp(n->child2()); }
+        void visit(NodeTag<NodeType::LOOP>, Node* n, int)   { exp(n->child2()); }
+
+    private:
+        NodePool& pool;
+
+        // An EXP, M or N spine being walked, or a parenthesized R
+        // waiting for its exp
+        struct Level {
+            NodeType type;
+            Node* at;           // spine node reached, or the R
+            std::size_t base;   // its first entry in spine/lefts
+        };
+        std::vector<Level> levels;
+
+        // operator nodes of the spines being folded, with the value of
+        // each one's left operand; a level pushes above the levels
+        // enclosing it and pops its entries when it closes
+        std::vector<Node*> spine;
+        std::vector<Folded> lefts;
+
+        Folded exp(Node* root);
+        Node* enterN(Level& level);
+        Folded closeN(std::size_t base, Folded value);
+        Folded closeM(std::size_t base);
+        Folded closeExp(std::size_t base);
+        void setConst(Node* n, int v);
+    };
+
+    // Turn `n` (keeping its label) into the literal v: R -> NUM,
+    // N -> R | - N, M -> N, EXP -> M. Values too long for a literal
+    // keep their original subtree.
+    void ConstantFolder::setConst(Node* n, int v) {
+        if (v > MAX_LITERAL || v < -MAX_LITERAL) return;
+        if (n->label == NodeType::R && v < 0) return;   // only (exp) could hold it
+
+        int line = n->tk1().line;
+        n->clear();
+
+        switch (n->label) {
+            case NodeType::R:
+                n->tokenSlot(1) = Token{TokenID::NUM_tk, TokenKind::NUM_tk, Lexeme(std::to_string(v)), line};
+                break;
+            case NodeType::N:
+                if (v < 0) {
+                    n->tokenSlot(1) = Token{TokenID::OP_tk, TokenKind::MINUS_tk, "-", line};
+                    n->childSlot(1) = pool.create(NodeType::N);
+                    setConst(n->child1(), -v);
+                } else {
+                    n->childSlot(1) = pool.create(NodeType::R);
+                    setConst(n->child1(), v);
+                }
+                break;
+            case NodeType::M:
+                n->childSlot(1) = pool.create(NodeType::N);
+                setConst(n->child1(), v);
+                break;
+            default:   // EXP
+                n->childSlot(1) = pool.create(NodeType::M);
+                setConst(n->child1(), v);
+        }
+    }
+
+    // Expressions are walked as code generation walks them: down to a
+    // leaf, opening a level per spine entered, then back up, each
+    // value completing the current operand of the innermost open level.
+    // A level whose spine ends is folded by its close function, which
+    // pops its entries. `levels` keeps them, so parentheses nest
+    // without recursion.
+    Folded ConstantFolder::exp(Node* root) {
+        std::size_t base = levels.size();
+        Node* node = root;
+        Folded value;
+
+        for (;;) {
+            // descend
+            for (;;) {
+                if (!node) {
+                    value = unknown(false);
+                    break;
+                }
+                NodeType type = node->label;
+                if (type == NodeType::EXP || type == NodeType::M) {
+                    levels.push_back(Level{type, node, spine.size()});
+                    node = node->child1();
+                } else if (type == NodeType::N) {
+                    levels.push_back(Level{type, node, spine.size()});
+                    node = enterN(levels.back());
+                } else if (node->tk1().id == TokenID::IDENT_tk) {
+                    value = unknown(false);
+                    break;
+                } else if (node->tk1().id == TokenID::NUM_tk) {
+                    int v = 0;
+                    for (char c : node->tk1().instance.view()) v = v * 10 + (c - '0');
+                    value = constant(v);
+                    break;
+                } else {
+                    // ( exp ): the R is revisited once the exp is folded
+                    levels.push_back(Level{type, node, spine.size()});
+                    node = node->child1();
+                }
+            }
+
+            // climb
+            for (;;) {
+                if (levels.size() == base) return value;
+                Level& level = levels.back();
+                Node* at = level.at;
+
+                if (level.type == NodeType::R) {
+                    if (value.known && value.value >= 0) setConst(at, value.value);   // drop the parentheses
+                } else if (level.type == NodeType::N) {
+                    if (at && at->tk2().kind == TokenKind::PERCENT_tk && at->child2()) {
+                        spine.push_back(at);
+                        lefts.push_back(value);
+                        level.at = at->child2();
+                        node = enterN(level);
+                        break;
+                    }
+                    value = closeN(level.base, value);
+                } else {
+                    spine.push_back(at);
+                    lefts.push_back(value);
+                    TokenKind k = at->tk1().kind;
+                    bool more = level.type == NodeType::M ? k == TokenKind::STAR_tk
+                                                          : k == TokenKind::PLUS_tk || k == TokenKind::MINUS_tk;
+                    if (more && at->child2()) {
+                        level.at = at->child2();
+                        node = level.at->child1();
+                        break;
+                    }
+                    value = level.type == NodeType::M ? closeM(level.base) : closeExp(level.base);
+                }
+                levels.pop_back();
+            }
+        }
+    }
+
+    // N -> - N | R % N | R
+    // Push the unary minuses starting at level.at (their left operand
+    // is unused); returns the R the chain continues with
+    Node* ConstantFolder::enterN(Level& level) {
+        Node* n = level.at;
+        while (n && n->tk1().kind == TokenKind::MINUS_tk) {
+            spine.push_back(n);
+            lefts.push_back(Folded());
+            n = n->child1();
+        }
+        level.at = n;
+        return n ? n->child1() : nullptr;
+    }
+
+    // Fold an N spine whose last operand is `value`
+    Folded ConstantFolder::closeN(std::size_t base, Folded value) {
+        for (std::size_t i = spine.size(); i-- > base; ) {
+            Node* at = spine[i];
+            int v;
+            if (at->tk1().kind == TokenKind::MINUS_tk) {
+                Node* below = at->child1();
+                if (value.known && checked(-static_cast<long long>(value.value), v)) {
+                    setConst(at, v);
+                    value = constant(v);
+                } else if (value.known) {
+                    value = unknown(false);
+                } else if (below->tk1().kind == TokenKind::MINUS_tk) {
+                    at->copySlots(*below->child1()); // - - x is x
+                }
+                continue;
+            }
+            const Folded& left = lefts[i];
+            bool divisorNonzero = value.known && value.value != 0;
+            if (left.known && value.known && modulo(left.value, value.value, v)) {
+                setConst(at, v);
+                value = constant(v);
+            } else if (!left.mayTrap && (isConst(value, 1) || isConst(value, -1))) {
+                setConst(at, 0);                    // x % 1 is 0
+                value = constant(0);
+            } else {
+                value = unknown(left.mayTrap || value.mayTrap || !divisorNonzero);
+            }
+        }
+        spine.resize(base);
+        lefts.resize(base);
+        return value;
+    }
+
+    // M -> N * M | N
+    Folded ConstantFolder::closeM(std::size_t base) {
+        Folded right = lefts.back();
+        for (std::size_t i = spine.size() - 1; i-- > base; ) {
+            Node* at = spine[i];
+            const Folded& a = lefts[i];
+            int v;
+            if (a.known && right.known && checked(static_cast<long long>(a.value) * right.value, v)) {
+                setConst(at, v);
+                right = constant(v);
+            } else if ((isConst(a, 0) && !right.mayTrap) || (isConst(right, 0) && !a.mayTrap)) {
+                setConst(at, 0);                    // x * 0 is 0
+                right = constant(0);
+            } else if (isConst(right, 1)) {
+                at->tokenSlot(1) = NO_TOKEN;        // x * 1 is x
+                at->childSlot(2) = nullptr;
+                right = a;
+            } else if (isConst(a, 1)) {
+                at->copySlots(*spine[i + 1]);       // 1 * x is x
+            } else {
+                right = unknown(a.mayTrap || right.mayTrap);
+            }
+        }
+        spine.resize(base);
+        lefts.resize(base);
+        return right;
+    }
+
+    // EXP -> M + EXP | M - EXP | M
+    Folded ConstantFolder::closeExp(std::size_t base) {
+        Folded right = lefts.back();
+        for (std::size_t i = spine.size() - 1; i-- > base; ) {
+            Node* at = spine[i];
+            const Folded& a = lefts[i];
+            bool plus = at->tk1().kind == TokenKind::PLUS_tk;
+            long long exact = plus ? static_cast<long long>(a.value) + right.value
+                                   : static_cast<long long>(a.value) - right.value;
+            int v;
+            if (a.known && right.known && checked(exact, v)) {
+                setConst(at, v);
+                right = constant(v);
+            } else if (isConst(right, 0)) {
+                at->tokenSlot(1) = NO_TOKEN;        // x + 0 and x - 0 are x
+                at->childSlot(2) = nullptr;
+                right = a;
+            } else if (plus && isConst(a, 0)) {
+                at->copySlots(*spine[i + 1]);       // 0 + x is x
+            } else {
+                right = unknown(a.mayTrap || right.mayTrap);
+            }
+        }
+        spine.resize(base);
+        lefts.resize(base);
+        return right;
+    }
+
+    void foldConstants(CompileContext& cx, Node* root) {
+        ConstantFolder folder(cx.nodes);
+        traverse(root, folder);
+    }
+
+    // ---------- propagate-constants ----------
+
+    // A temp written once, from a constant, and read only later in the
+    // same basic block is replaced by the constant (the target takes
+    // integer operands directly), and its copy is dropped
+    void propagateConstants(IrUnit& u) {
+        std::vector<IrInstr>& code = u.code;
+        std::size_t temps = static_cast<std::size_t>(u.tempCount);
+        if (temps == 0) return;
+
+        std::vector<int> defs(temps, 0), uses(temps, 0);
+        for (const IrInstr& ins : code) {
+            if (ins.dst.isTemp()) ++defs[static_cast<std::size_t>(ins.dst.id)];
+            for (const IrOperand* o : {&ins.a, &ins.b})
+                if (o->isTemp()) ++uses[static_cast<std::size_t>(o->id)];
+        }
+
+        std::vector<int> value(temps, -1);              // constant index, or -1
+        std::vector<std::size_t> block(temps, 0);       // block it was set in
+        std::size_t cur = 0;
+        for (IrInstr& ins : code) {
+            if (ins.op == IrOp::Label) ++cur;
+            for (IrOperand* o : {&ins.a, &ins.b}) {
+                if (!o->isTemp()) continue;
+                std::size_t t = static_cast<std::size_t>(o->id);
+                if (value[t] < 0 || block[t] != cur) continue;
+                *o = IrOperand::constant(value[t]);
+                --uses[t];
+            }
+            if (ins.op == IrOp::Copy && ins.dst.isTemp() && ins.a.kind == IrOperand::Kind::Const &&
+                defs[static_cast<std::size_t>(ins.dst.id)] == 1) {
+                value[static_cast<std::size_t>(ins.dst.id)] = ins.a.id;
+                block[static_cast<std::size_t>(ins.dst.id)] = cur;
+            }
+            if (ins.op == IrOp::Jump || ins.op == IrOp::JumpIf) ++cur;
+        }
+
+        // drop the copies nothing reads any more
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < code.size(); ++i) {
+            const IrInstr& ins = code[i];
+            if (ins.op == IrOp::Copy && ins.dst.isTemp()) {
+                std::size_t t = static_cast<std::size_t>(ins.dst.id);
+                if (value[t] >= 0 && uses[t] == 0) continue;
+            }
+            if (kept != i) code[kept] = code[i];
+            ++kept;
+        }
+        code.resize(kept);
+    }
+
+    // ---------- merge-labels ----------
+
+    // Consecutive labels (an if ending where a loop ends, say) mark the
+    // same point: keep the first, drop the others and send their
+    // branches to it, saving a NOOP per dropped label
+    void mergeLabels(IrUnit& u) {
+        std::vector<IrInstr>& code = u.code;
+        std::vector<int> alias(u.labels.size(), -1);
+        bool merged = false;
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < code.size(); ++i) {
+            if (code[i].op == IrOp::Label && kept > 0 && code[kept - 1].op == IrOp::Label) {
+                alias[static_cast<std::size_t>(code[i].label)] = code[kept - 1].label;
+                merged = true;
+                continue;
+            }
+            if (kept != i) code[kept] = code[i];
+            ++kept;
+        }
+        code.resize(kept);
+        if (!merged) return;
+
+        for (IrInstr& ins : code) {
+            if (ins.op != IrOp::Jump && ins.op != IrOp::JumpIf) continue;
+            int to = alias[static_cast<std::size_t>(ins.label)];
+            if (to >= 0) ins.label = to;
+        }
+    }
+
+    // ---------- reuse-temps ----------
+
+    // Temps are renumbered to storage slots by coloring an interference
+    // graph: two temps interfere when one is defined while the other is
+    // live, and interfering temps get different slots. Instructions
+    // read their operands before writing dst, so a temp dying in an
+    // instruction can share a slot with the one it defines.
+    //
+    // Generated temps live within one basic block. Such a temp is never
+    // live outside the span from its first to its last appearance, so
+    // their graph is an interval graph: coloring in order of first
+    // appearance, a temp's colored neighbours are the temps whose span
+    // is still open, and a forward scan with a free-slot heap colors it
+    // optimally without building the edges (wide expressions keep
+    // hundreds of temps live at once). Temps read in some block before
+    // being written there ("global" temps) are live across blocks; only
+    // they take part in dataflow and get explicit edges.
+
+    // A dense set of temp indices with O(1) insert and erase
+    class TempSet {
+    public:
+        explicit TempSet(std::size_t temps) : pos(temps, -1) {}
+
+        void insert(int t) {
+            if (pos[static_cast<std::size_t>(t)] >= 0) return;
+            pos[static_cast<std::size_t>(t)] = static_cast<int>(items.size());
+            items.push_back(t);
+        }
+        void erase(int t) {
+            int i = pos[static_cast<std::size_t>(t)];
+            if (i < 0) return;
+            int last = items.back();
+            items[static_cast<std::size_t>(i)] = last;
+            pos[static_cast<std::size_t>(last)] = i;
+            items.pop_back();
+            pos[static_cast<std::size_t>(t)] = -1;
+        }
+        bool contains(int t) const { return pos[static_cast<std::size_t>(t)] >= 0; }
+        void clear() { while (!items.empty()) erase(items.back()); }
+        const std::vector<int>& members() const { return items; }
+
+    private:
+        std::vector<int> pos;     // index in items, or -1
+        std::vector<int> items;
+    };
+
+    // Bit sets over the global temps, one word vector per block
+    using Bits = std::vector<std::uint64_t>;
+
+    void setBit(Bits& b, std::size_t i) { b[i / 64] |= std::uint64_t{1} << (i % 64); }
+
+    // Temps read by `ins`, in operand order
+    int tempUses(const IrInstr& ins, int out[2]) {
+        int n = 0;
+        if (ins.a.isTemp()) out[n++] = ins.a.id;
+        if (ins.b.isTemp()) out[n++] = ins.b.id;
+        return n;
+    }
+
+    // Temp reads and writes of the IR and of the selected assembly, for
+    // the liveness helpers below
+    struct IrAccess {
+        const std::vector<IrInstr>& code;
+        int uses(std::size_t i, int out[2]) const { return tempUses(code[i], out); }
+        int def(std::size_t i) const { return code[i].dst.isTemp() ? code[i].dst.id : -1; }
+    };
+
+    struct AsmAccess {
+        const std::vector<AsmInstr>& code;
+        int uses(std::size_t i, int out[2]) const {
+            const AsmInstr& ins = code[i];
+            if (!ins.arg.isTemp() || ins.op == AsmOp::STORE || ins.op == AsmOp::READ) return 0;
+            out[0] = ins.arg.id;
+            return 1;
+        }
+        int def(std::size_t i) const {
+            const AsmInstr& ins = code[i];
+            bool writes = ins.op == AsmOp::STORE || ins.op == AsmOp::READ;
+            return writes && ins.arg.isTemp() ? ins.arg.id : -1;
+        }
+    };
+
+    // Global temps, as a dense index per temp (or -1), with their list
+    template <class Access>
+    std::vector<int> findGlobals(const Access& code, const std::vector<IrBlock>& blocks,
+                                 std::size_t temps, std::vector<int>& globals) {
+        std::vector<std::size_t> seenIn(temps, SIZE_MAX);   // block that last wrote it
+        std::vector<int> global(temps, -1);
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            for (std::size_t i = blocks[b].begin; i < blocks[b].end; ++i) {
+                int uses[2];
+                for (int k = 0, n = code.uses(i, uses); k < n; ++k) {
+                    std::size_t t = static_cast<std::size_t>(uses[k]);
+                    if (seenIn[t] == b || global[t] >= 0) continue;
+                    global[t] = static_cast<int>(globals.size());
+                    globals.push_back(uses[k]);
+                }
+                if (code.def(i) >= 0) seenIn[static_cast<std::size_t>(code.def(i))] = b;
+            }
+        }
+        return global;
+    }
+
+    // Live global temps at the end of each block
+    template <class Access>
+    std::vector<std::vector<int>> liveOut(const Access& code, const std::vector<IrBlock>& blocks,
+                                          const std::vector<int>& global,
+                                          const std::vector<int>& globals) {
+        std::vector<std::vector<int>> out(blocks.size());
+        if (globals.empty()) return out;
+
+        // per block: globals read before written (gen) and written (kill)
+        std::size_t words = (globals.size() + 63) / 64;
+        std::vector<Bits> gen(blocks.size(), Bits(words)), kill(blocks.size(), Bits(words));
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            for (std::size_t i = blocks[b].begin; i < blocks[b].end; ++i) {
+                int uses[2];
+                for (int k = 0, n = code.uses(i, uses); k < n; ++k) {
+                    int g = global[static_cast<std::size_t>(uses[k])];
+                    if (g < 0) continue;
+                    std::size_t w = static_cast<std::size_t>(g) / 64;
+                    std::uint64_t bit = std::uint64_t{1} << (g % 64);
+                    if (!(kill[b][w] & bit)) gen[b][w] |= bit;
+                }
+                if (code.def(i) >= 0) {
+                    int g = global[static_cast<std::size_t>(code.def(i))];
+                    if (g >= 0) setBit(kill[b], static_cast<std::size_t>(g));
+                }
+            }
+        }
+
+        // backward dataflow to a fixed point
+        std::vector<Bits> in(blocks.size(), Bits(words)), outBits(blocks.size(), Bits(words));
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (std::size_t b = blocks.size(); b-- > 0; ) {
+                Bits& o = outBits[b];
+                for (std::size_t s : blocks[b].succs)
+                    for (std::size_t w = 0; w < words; ++w) o[w] |= in[s][w];
+                for (std::size_t w = 0; w < words; ++w) {
+                    std::uint64_t v = gen[b][w] | (o[w] & ~kill[b][w]);
+                    if (v != in[b][w]) { in[b][w] = v; changed = true; }
+                }
+            }
+        }
+
+        for (std::size_t b = 0; b < blocks.size(); ++b)
+            for (std::size_t g = 0; g < globals.size(); ++g)
+                if (outBits[b][g / 64] >> (g % 64) & 1) out[b].push_back(globals[g]);
+        return out;
+    }
+
+    void reuseTemps(IrUnit& u) {
+        std::vector<IrInstr>& code = u.code;
+        std::size_t temps = static_cast<std::size_t>(u.tempCount);
+        if (code.empty() || temps == 0) return;
+
+        std::vector<IrBlock> blocks = basicBlocks(u);
+        std::vector<int> globals;
+        std::vector<int> global = findGlobals(IrAccess{code}, blocks, temps, globals);
+
+        // edges with a global temp, walking each block backwards from its
+        // live-out set; a local temp's edges with other locals are implied
+        std::vector<std::pair<int, int>> edges;
+        if (!globals.empty()) {
+            std::vector<std::vector<int>> live = liveOut(IrAccess{code}, blocks, global, globals);
+            TempSet now(temps), nowGlobal(temps);
+            for (std::size_t b = 0; b < blocks.size(); ++b) {
+                for (int t : live[b]) {
+                    now.insert(t);
+                    nowGlobal.insert(t);
+                }
+                for (std::size_t i = blocks[b].end; i-- > blocks[b].begin; ) {
+                    const IrInstr& ins = code[i];
+                    if (ins.dst.isTemp()) {
+                        int d = ins.dst.id;
+                        now.erase(d);
+                        nowGlobal.erase(d);
+                        const TempSet& with = global[static_cast<std::size_t>(d)] >= 0 ? now : nowGlobal;
+                        for (int t : with.members()) edges.emplace_back(d, t);
+                    }
+                    int uses[2];
+                    for (int k = 0, n = tempUses(ins, uses); k < n; ++k) {
+                        now.insert(uses[k]);
+                        if (global[static_cast<std::size_t>(uses[k])] >= 0) nowGlobal.insert(uses[k]);
+                    }
+                }
+                now.clear();
+                nowGlobal.clear();
+            }
+        }
+
+        // adjacency lists, both directions, in one array
+        std::vector<std::size_t> first(temps + 1, 0);
+        for (const auto& e : edges) {
+            ++first[static_cast<std::size_t>(e.first) + 1];
+            ++first[static_cast<std::size_t>(e.second) + 1];
+        }
+        for (std::size_t t = 0; t < temps; ++t) first[t + 1] += first[t];
+        std::vector<int> adj(first[temps]);
+        std::vector<std::size_t> fill(first.begin(), first.end() - 1);
+        for (const auto& e : edges) {
+            adj[fill[static_cast<std::size_t>(e.first)]++] = e.second;
+            adj[fill[static_cast<std::size_t>(e.second)]++] = e.first;
+        }
+        std::vector<std::pair<int, int>>().swap(edges);
+
+        // where each temp's span ends
+        std::vector<std::size_t> lastAt(temps, 0);
+        for (std::size_t i = 0; i < code.size(); ++i)
+            for (const IrOperand* o : {&code[i].a, &code[i].b, &code[i].dst})
+                if (o->isTemp()) lastAt[static_cast<std::size_t>(o->id)] = i;
+
+        // greedy coloring in order of first appearance; open[c] counts
+        // the local temps holding slot c whose span is open
+        std::vector<int> slot(temps, -1);
+        std::vector<bool> isOpen(temps, false);
+        std::vector<int> open;
+        std::vector<std::size_t> taken;   // taken[c] == t + 1: a global neighbour of t has slot c
+        std::priority_queue<int, std::vector<int>, std::greater<int>> freeSlots;
+        auto color = [&](std::size_t t) {
+            int c = -1;
+            if (first[t] == first[t + 1]) {
+                while (!freeSlots.empty() && c < 0) {
+                    if (open[static_cast<std::size_t>(freeSlots.top())] == 0) c = freeSlots.top();
+                    freeSlots.pop();
+                }
+            } else {
+                for (std::size_t k = first[t]; k < first[t + 1]; ++k) {
+                    int n = slot[static_cast<std::size_t>(adj[k])];
+                    if (n >= 0) taken[static_cast<std::size_t>(n)] = t + 1;
+                }
+                for (std::size_t n = 0; n < open.size() && c < 0; ++n)
+                    if (open[n] == 0 && taken[n] != t + 1) c = static_cast<int>(n);
+            }
+            if (c < 0) {
+                c = static_cast<int>(open.size());
+                open.push_back(0);
+                taken.push_back(0);
+            }
+            slot[t] = c;
+        };
+        auto openSpan = [&](std::size_t t) {
+            if (global[t] >= 0 || isOpen[t]) return;
+            isOpen[t] = true;
+            ++open[static_cast<std::size_t>(slot[t])];
+        };
+        auto closeSpan = [&](std::size_t t) {
+            if (!isOpen[t]) return;
+            isOpen[t] = false;
+            if (--open[static_cast<std::size_t>(slot[t])] == 0) freeSlots.push(slot[t]);
+        };
+
+        for (std::size_t i = 0; i < code.size(); ++i) {
+            IrInstr& ins = code[i];
+            IrOperand* uses[] = {&ins.a, &ins.b};
+            for (IrOperand* o : uses) {
+                if (!o->isTemp()) continue;
+                std::size_t t = static_cast<std::size_t>(o->id);
+                if (slot[t] < 0) color(t);
+                openSpan(t);
+            }
+            // operands are read before dst is written
+            for (IrOperand* o : uses)
+                if (o->isTemp() && lastAt[static_cast<std::size_t>(o->id)] == i && *o != ins.dst)
+                    closeSpan(static_cast<std::size_t>(o->id));
+            if (ins.dst.isTemp()) {
+                std::size_t d = static_cast<std::size_t>(ins.dst.id);
+                if (slot[d] < 0) color(d);
+                openSpan(d);
+                if (lastAt[d] == i) closeSpan(d);
+            }
+            for (IrOperand* o : {&ins.a, &ins.b, &ins.dst})
+                if (o->isTemp()) o->id = slot[static_cast<std::size_t>(o->id)];
+        }
+
+        u.tempCount = std::max(u.tempBase, static_cast<int>(open.size()));
+    }
+
+    // ---------- peephole ----------
+
+    // Runs over the selected assembly, modelling the accumulator:
+    //   redundant-load   LOAD x while the accumulator already holds x
+    //   redundant-store  STORE x while x already holds the accumulator
+    //   dead-store       STORE _t whose value is never read
+    //   dead-load        LOAD x overwritten before anything reads it
+    //   unused-temp      a temp left with no references, dropped from storage
+    // The first two need only a forward scan; the dead ones use temp
+    // liveness (the reuse-temps helpers) and, at block ends, assume the
+    // accumulator is read.
+    const std::size_t REDUNDANT_LOAD = 0;
+    const std::size_t REDUNDANT_STORE = 1;
+    const std::size_t DEAD_STORE = 2;
+    const std::size_t DEAD_LOAD = 3;
+    const std::size_t UNUSED_TEMP = 4;
+
+    bool isArithmetic(AsmOp op) {
+        return op == AsmOp::ADD || op == AsmOp::SUB || op == AsmOp::MULT || op == AsmOp::DIV;
+    }
+
+    // Drop the instructions marked in `drop`; true if there were any
+    bool compact(std::vector<AsmInstr>& code, const std::vector<bool>& drop) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < code.size(); ++i)
+            if (!drop[i]) code[kept++] = code[i];
+        bool changed = kept != code.size();
+        code.resize(kept);
+        return changed;
+    }
+
+    bool dropRedundant(std::vector<AsmInstr>& code, std::size_t* hits) {
+        std::vector<bool> drop(code.size(), false);
+        std::vector<IrOperand> holds;   // locations known to equal the accumulator
+        auto held = [&holds](const IrOperand& o) {
+            return std::find(holds.begin(), holds.end(), o) != holds.end();
+        };
+
+        for (std::size_t i = 0; i < code.size(); ++i) {
+            const AsmInstr& ins = code[i];
+            if (ins.label >= 0) holds.clear();   // control joins here
+            switch (ins.op) {
+                case AsmOp::LOAD:
+                    if (held(ins.arg)) {
+                        drop[i] = true;
+                        ++hits[REDUNDANT_LOAD];
+                    } else {
+                        holds.assign(1, ins.arg);
+                    }
+                    break;
+                case AsmOp::STORE:
+                    if (held(ins.arg)) {
+                        drop[i] = true;
+                        ++hits[REDUNDANT_STORE];
+                    } else {
+                        holds.push_back(ins.arg);
+                    }
+                    break;
+                case AsmOp::READ:
+                    holds.erase(std::remove(holds.begin(), holds.end(), ins.arg), holds.end());
+                    break;
+                case AsmOp::BR:
+                    holds.clear();
+                    break;
+                default:
+                    if (isArithmetic(ins.op)) holds.clear();
+            }
+        }
+        return compact(code, drop);
+    }
+
+    bool dropDead(IrUnit& u, std::size_t* hits) {
+        std::vector<AsmInstr>& code = u.target;
+        std::size_t temps = static_cast<std::size_t>(u.tempCount);
+        std::vector<IrBlock> blocks = targetBlocks(u);
+        std::vector<int> globals;
+        std::vector<int> global = findGlobals(AsmAccess{code}, blocks, temps, globals);
+        std::vector<std::vector<int>> live = liveOut(AsmAccess{code}, blocks, global, globals);
+
+        std::vector<bool> drop(code.size(), false);
+        TempSet now(temps);
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            for (int t : live[b]) now.insert(t);
+            bool accRead = true;
+            for (std::size_t i = blocks[b].end; i-- > blocks[b].begin; ) {
+                const AsmInstr& ins = code[i];
+                bool temp = ins.arg.isTemp();
+                switch (ins.op) {
+                    case AsmOp::STORE:
+                        if (temp && !now.contains(ins.arg.id)) {
+                            drop[i] = true;
+                            ++hits[DEAD_STORE];
+                            break;
+                        }
+                        if (temp) now.erase(ins.arg.id);
+                        accRead = true;
+                        break;
+                    case AsmOp::READ:
+                        if (temp) now.erase(ins.arg.id);
+                        break;
+                    case AsmOp::LOAD:
+                        if (!accRead) {
+                            drop[i] = true;
+                            ++hits[DEAD_LOAD];
+                            break;
+                        }
+                        if (temp) now.insert(ins.arg.id);
+                        accRead = false;
+                        break;
+                    case AsmOp::WRITE:
+                    case AsmOp::NOOP:
+                        if (temp) now.insert(ins.arg.id);
+                        break;
+                    default:   // arithmetic reads the accumulator, branches test it
+                        if (temp) now.insert(ins.arg.id);
+                        accRead = true;
+                }
+            }
+            now.clear();
+        }
+        return compact(code, drop);
+    }
+
+    // Renumber the temps still referenced densely; the rest lose their
+    // storage slots
+    void dropUnusedTemps(IrUnit& u, std::size_t* hits, std::size_t referenced) {
+        std::vector<int> renamed(static_cast<std::size_t>(u.tempCount), -1);
+        int count = 0;
+        for (AsmInstr& ins : u.target) {
+            if (!ins.arg.isTemp()) continue;
+            int& r = renamed[static_cast<std::size_t>(ins.arg.id)];
+            if (r < 0) r = count++;
+            ins.arg.id = r;
+        }
+        hits[UNUSED_TEMP] += referenced - static_cast<std::size_t>(count);
+        u.tempCount = std::max(u.tempBase, count);
+    }
+
+    std::size_t referencedTemps(const IrUnit& u) {
+        std::vector<bool> seen(static_cast<std::size_t>(u.tempCount), false);
+        std::size_t n = 0;
+        for (const AsmInstr& ins : u.target) {
+            if (!ins.arg.isTemp() || seen[static_cast<std::size_t>(ins.arg.id)]) continue;
+            seen[static_cast<std::size_t>(ins.arg.id)] = true;
+            ++n;
+        }
+        return n;
+    }
+
+    void peephole(IrUnit& u, std::size_t* hits) {
+        if (u.target.empty()) return;
+        std::size_t referenced = referencedTemps(u);
+        // each round removes something, and removals can enable others
+        while (dropRedundant(u.target, hits) | dropDead(u, hits)) {}
+        dropUnusedTemps(u, hits, referenced);
+    }
+
+    // ---------- registry ----------
+
+    const std::vector<PassInfo> PASSES = {
+        {"fold-constants", 1, "evaluate constant subexpressions and apply identities like x * 1",
+         foldConstants, nullptr, nullptr, false, {}},
+        {"merge-labels", 1, "fold runs of adjacent labels into one", nullptr, mergeLabels, nullptr, false, {}},
+        {"propagate-constants", 1, "use literals as operands instead of loading them into temps",
+         nullptr, propagateConstants, nullptr, false, {}},
+        {"reuse-temps", 1, "share storage slots between temps whose lifetimes do not overlap",
+         nullptr, reuseTemps, nullptr, true, {}},
+        {"peephole", 2, "track the accumulator to drop redundant and dead loads and stores",
+         nullptr, nullptr, peephole, false,
+         {"redundant-load", "redundant-store", "dead-store", "dead-load", "unused-temp"}},
+    };
+
+    // Nodes in the tree, the size measure for tree passes
+    struct NodeCounter : TreePass {
+        std::size_t count = 0;
+
+        template <NodeType T>
+        void visit(NodeTag<T>, Node*, int) { ++count; }
+    };
+
+    std::size_t countNodes(Node* root) {
+        NodeCounter c;
+        traverse(root, c);
+        return c.count;
+    }
+
+    double nowMs() {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Temp slots the unit's code added to the storage section. Summed
+    // over the statements of --stream, it adds up to the program's total.
+    std::size_t tempSlots(const IrUnit& u) {
+        return static_cast<std::size_t>(u.tempCount - u.tempBase);
+    }
+
+    // Passes may run once per statement (--stream); runs add up
+    void record(CompileContext& cx, const PassInfo& p, double ms,
+                std::size_t before, std::size_t after,
+                const std::vector<std::size_t>& hits = std::vector<std::size_t>()) {
+        PassStats* s = nullptr;
+        for (PassStats& run : cx.stats.passes)
+            if (std::strcmp(run.name, p.name) == 0) s = &run;
+        if (!s) {
+            cx.stats.passes.push_back(PassStats{
+                p.name, p.tree ? "nodes" : p.sizesTemps ? "temps" : "instructions",
+                0, 0, 0, {}});
+            s = &cx.stats.passes.back();
+            for (const char* rule : p.rules) s->rules.push_back(RuleStats{rule, 0});
+        }
+        s->wallMs += ms;
+        s->before += before;
+        s->after += after;
+        for (std::size_t i = 0; i < hits.size(); ++i) s->rules[i].hits += hits[i];
+    }
+} // end anonymous namespace
+
+const std::vector<PassInfo>& passRegistry() {
+    return PASSES;
+}
+
+unsigned passesForLevel(int level) {
+    unsigned mask = 0;
+    for (std::size_t i = 0; i < PASSES.size(); ++i)
+        if (PASSES[i].level <= level) mask |= 1u << i;
+    return mask;
+}
+
+int findPass(const std::string& name) {
+    for (std::size_t i = 0; i < PASSES.size(); ++i)
+        if (name == PASSES[i].name) return static_cast<int>(i);
+    return -1;
+}
+
+std::string passNames(unsigned mask) {
+    std::string names;
+    for (std::size_t i = 0; i < PASSES.size(); ++i) {
+        if (!(mask & (1u << i))) continue;
+        if (!names.empty()) names += ' ';
+        names += PASSES[i].name;
+    }
+    return names;
+}
+
+void runTreePasses(CompileContext& cx, Node* root) {
+    for (std::size_t i = 0; i < PASSES.size(); ++i) {
+        const PassInfo& p = PASSES[i];
+        if (!p.tree || !(cx.opts.passes & (1u << i))) continue;
+        std::size_t before = countNodes(root);
+        double t0 = nowMs();
+        p.tree(cx, root);
+        double ms = nowMs() - t0;
+        record(cx, p, ms, before, countNodes(root));
+    }
+}
+
+void runIrPasses(CompileContext& cx, IrUnit& unit) {
+    for (std::size_t i = 0; i < PASSES.size(); ++i) {
+        const PassInfo& p = PASSES[i];
+        if (!p.ir || !(cx.opts.passes & (1u << i))) continue;
+        std::size_t before = p.sizesTemps ? tempSlots(unit) : targetSize(unit);
+        double t0 = nowMs();
+        p.ir(unit);
+        double ms = nowMs() - t0;
+        record(cx, p, ms, before, p.sizesTemps ? tempSlots(unit) : targetSize(unit));
+    }
+}
+
+void runTargetPasses(CompileContext& cx, IrUnit& unit) {
+    for (std::size_t i = 0; i < PASSES.size(); ++i) {
+        const PassInfo& p = PASSES[i];
+        if (!p.target || !(cx.opts.passes & (1u << i))) continue;
+        std::vector<std::size_t> hits(p.rules.size(), 0);
+        std::size_t before = unit.target.size();
+        double t0 = nowMs();
+        p.target(unit, hits.data());
+        double ms = nowMs() - t0;
+        record(cx, p, ms, before, unit.target.size(), hits);
+    }
+}
+
+void reportPasses(CompileContext& cx) {
+    for (const PassStats& s : cx.stats.passes) {
+        cx.err << "pass " << s.name << ": " << s.wallMs << " ms, "
+               << s.before << " -> " << s.after << ' ' << s.unit << '\n';
+        for (const RuleStats& r : s.rules)
+            cx.err << "  " << r.name << ": " << r.hits << '\n';
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include <string>
+#include <vector>
+#include "node.h"
+
+struct CompileContext;
+struct IrUnit;
+
+// Pass manager: the optimization passes that run between static
+// semantics and emission. Tree passes rewrite the checked parse tree
+// before code generation; IR passes rewrite the three-address code it
+// is lowered to, and target passes the selected assembly (both in an
+// IrUnit, ir.h) before it is written out.
+// -O<level> picks every pass whose level is at most <level>, and
+// -f<name> / -fno-<name> switch single passes on or off; -O0 runs none,
+// so its output is exactly the unoptimized code.
+//
+// In --stream mode every kind sees one top-level statement at a time.
+
+struct PassInfo {
+    const char* name;       // as in -f<name>
+    int level;              // lowest -O level that runs it
+    const char* summary;    // one line for the usage text
+    void (*tree)(CompileContext& cx, Node* root);   // exactly one of
+    void (*ir)(IrUnit& unit);                        // these is set
+    void (*target)(IrUnit& unit, std::size_t* hits); // hits: a counter per rule
+    bool sizesTemps;        // IR pass: --pass-stats counts temp slots, not instructions
+    std::vector<const char*> rules;   // target pass: rewrite rules it counts hits of
+};
+
+// Every pass, in the order they run (tree, then IR, then target passes)
+const std::vector<PassInfo>& passRegistry();
+
+// Passes enabled by -O<level>, as a mask over passRegistry() indices
+unsigned passesForLevel(int level);
+
+// passRegistry() index of the pass called `name`, or -1
+int findPass(const std::string& name);
+
+// The names of the passes in `mask`, space separated (for cache keys)
+std::string passNames(unsigned mask);
+
+// Run the enabled tree passes (cx.opts.passes) over `root`
+void runTreePasses(CompileContext& cx, Node* root);
+
+// Run the enabled IR passes over unit.code
+void runIrPasses(CompileContext& cx, IrUnit& unit);
+
+// Run the enabled target passes over unit.target
+void runTargetPasses(CompileContext& cx, IrUnit& unit);
+
+// "pass <name>: <ms> ms, <before> -> <after> <unit>" per pass run, on cx.err
+void reportPasses(CompileContext& cx);
+
+#endif // OPTIMIZER_H
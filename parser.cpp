@@ -1,30 +1,13 @@
-#include <iostream>
-#include <cstdlib>
+#include <functional>
 #include <string>
+#include <vector>
 #include "parser.h"
-#include "scanner.h"
+#include "codeGen.h"
+#include "compiler.h"
+#include "statSem.h"
 
 // ---------- helpers ----------
 
-static Token tk;   // current lookahead token
-
-static void getNextToken() {
-    tk = scanner();
-}
-
-static void parseError(const std::string& msg) {
-    std::cout << "ERROR: " << msg << " at line " << tk.line << std::endl;
-    std::exit(1);
-}
-
-static bool isKw(const Token& t, const std::string& kw) {
-    return t.id == TokenID::KW_tk && t.instance == kw;
-}
-
-static bool isOp(const Token& t, const std::string& op) {
-    return t.id == TokenID::OP_tk && t.instance == op;
-}
-
 static bool isId(const Token& t) {
     return t.id == TokenID::IDENT_tk;
 }
@@ -33,28 +16,111 @@ static bool isNum(const Token& t) {
     return t.id == TokenID::NUM_tk;
 }
 
-// forward declarations
-static Node* program();
-static Node* vars();
-static Node* varList();
-static Node* block();
-static Node* stats();
-static Node* mStat();
-static Node* stat();
-static Node* readStmt();
-static Node* printStmt();
-static Node* cond();
-static Node* loopStmt();
-static Node* assign();
-static Node* relational();
-static Node* exp();
-static Node* M();
-static Node* N();
-static Node* R();
+namespace {
+    // Recursive-descent parser for one compilation. Nesting (blocks,
+    // if/while bodies, parentheses) and lists are parsed with loops and
+    // explicit stacks, so no input depth turns into C++ call depth.
+    class Parser {
+    public:
+        // sem/storage are non-null only in single-pass mode, onStatement
+        // only in streaming mode
+        Parser(CompileContext& cx, SemanticsPass* sem, StorageCollector* storage,
+               const std::function<void(Node*)>* onStatement = nullptr)
+            : cx(cx), sem(sem), storage(storage), onStatement(onStatement) {}
+
+        Node* run();
+
+    private:
+        CompileContext& cx;
+        Token tk;   // current lookahead token
+
+        // semantic actions (single-pass mode only)
+        SemanticsPass* sem;
+        StorageCollector* storage;
+        const std::function<void(Node*)>* onStatement;
+
+        void getNextToken() {
+            tk = cx.scanner.next();
+        }
+
+        [[noreturn]] void parseError(const std::string& msg) {
+            cx.out << "ERROR: " << msg << " at line " << tk.line << '\n';
+            throw CompileError{};
+        }
+
+        Node* createNode(NodeType t) {
+            return cx.nodes.create(t);
+        }
+
+        template <NodeType T>
+        void act(Node* n) {
+            if (sem) {
+                sem->visit(NodeTag<T>{}, n, 0);
+                storage->visit(NodeTag<T>{}, n, 0);
+            }
+        }
+
+        template <NodeType T>
+        void actLeave(Node* n) {
+            if (sem) sem->leave(NodeTag<T>{}, n, 0);
+        }
+
+        // A block whose statements stat() is still parsing, and where
+        // the MSTAT for its next statement goes
+        struct OpenBlock {
+            Node* block;
+            Node** next;
+        };
+
+        // The operator nodes exp() had reached when it entered a
+        // parenthesized R, resumed once the ')' is read
+        struct OpenParen {
+            Node* e;
+            Node* m;
+            Node* n;
+            Node* r;
+        };
+
+        // stat()'s and exp()'s explicit stacks, kept between calls
+        std::vector<OpenBlock> blocks;
+        std::vector<OpenParen> parens;
+
+        Node* program();
+        Node* vars();
+        Node* varList();
+        Node* block();
+        Node* openBlock();
+        void closeBlock(Node* n);
+        Node* stats();
+        Node* streamStats();
+        Node* mStat();
+        Node* stat();
+        Node* readStmt();
+        Node* printStmt();
+        Node* cond();
+        Node* loopStmt();
+        Node* assign();
+        Node* relational();
+        Node* exp();
+    };
+} // end anonymous namespace
 
 // ---------- public entry ----------
 
-Node* parser() {
+Node* parser(CompileContext& cx) {
+    return Parser(cx, nullptr, nullptr).run();
+}
+
+Node* parser(CompileContext& cx, SemanticsPass& sem, StorageCollector& storage) {
+    return Parser(cx, &sem, &storage).run();
+}
+
+Node* parser(CompileContext& cx, SemanticsPass& sem, StorageCollector& storage,
+             const std::function<void(Node*)>& onStatement) {
+    return Parser(cx, &sem, &storage, &onStatement).run();
+}
+
+Node* Parser::run() {
     getNextToken();
     Node* root = program();
 
@@ -67,42 +133,43 @@ Node* parser() {
 // ---------- nonterminals ----------
 
 // <program>  -> start <vars> <block> trats
-static Node* program() {
+Node* Parser::program() {
     Node* n = createNode(NodeType::PROGRAM);
 
-    if (!isKw(tk, "start")) {
+    if (tk.kind != TokenKind::START_tk) {
         parseError("expected 'start' at beginning of program");
     }
-    n->tk1 = tk;    // 'start'
+    n->tokenSlot(1) = tk;    // 'start'
     getNextToken();
 
-    n->child1 = vars();
-    n->child2 = block();
+    n->childSlot(1) = vars();
+    n->childSlot(2) = block();
 
-    if (!isKw(tk, "trats")) {
+    if (tk.kind != TokenKind::TRATS_tk) {
         parseError("expected 'trats' at end of program");
     }
-    n->tk2 = tk;    // 'trats'
+    n->tokenSlot(2) = tk;    // 'trats'
     getNextToken();
 
     return n;
 }
 
 // <vars> -> empty | var identifier ~ integer <varList> :
-static Node* vars() {
+Node* Parser::vars() {
     Node* n = createNode(NodeType::VARS);
 
-    if (isKw(tk, "var")) {
-        n->tk1 = tk;    // 'var'
+    if (tk.kind == TokenKind::VAR_tk) {
+        n->tokenSlot(1) = tk;    // 'var'
         getNextToken();
 
         if (!isId(tk)) {
             parseError("expected identifier after 'var'");
         }
-        n->tk2 = tk;    // identifier
+        n->tokenSlot(2) = tk;    // identifier
+        act<NodeType::VARS>(n);
         getNextToken();
 
-        if (!isOp(tk, "~")) {
+        if (tk.kind != TokenKind::TILDE_tk) {
             parseError("expected '~' in variable declaration");
         }
         getNextToken();
@@ -110,12 +177,12 @@ static Node* vars() {
         if (!isNum(tk)) {
             parseError("expected integer in variable declaration");
         }
-        n->tk3 = tk;    // integer
+        n->tokenSlot(3) = tk;    // integer
         getNextToken();
 
-        n->child1 = varList();
+        n->childSlot(1) = varList();
 
-        if (!isOp(tk, ":")) {
+        if (tk.kind != TokenKind::COLON_tk) {
             parseError("expected ':' after variable declarations");
         }
         getNextToken();
@@ -126,113 +193,193 @@ static Node* vars() {
 }
 
 // <varList> -> identifier ~ integer <varList> | empty
-static Node* varList() {
-    if (!isId(tk)) {
-        return nullptr; // epsilon
-    }
+// Built iteratively: one VARLIST per declaration, linked through child1.
+Node* Parser::varList() {
+    Node* head = nullptr;   // epsilon
+    Node** link = &head;
 
-    Node* n = createNode(NodeType::VARLIST);
+    while (isId(tk)) {
+        Node* n = createNode(NodeType::VARLIST);
+        *link = n;
 
-    n->tk1 = tk;    // identifier
-    getNextToken();
+        n->tokenSlot(1) = tk;    // identifier
+        act<NodeType::VARLIST>(n);
+        getNextToken();
 
-    if (!isOp(tk, "~")) {
-        parseError("expected '~' in varList");
-    }
-    getNextToken();
+        if (tk.kind != TokenKind::TILDE_tk) {
+            parseError("expected '~' in varList");
+        }
+        getNextToken();
 
-    if (!isNum(tk)) {
-        parseError("expected integer in varList");
+        if (!isNum(tk)) {
+            parseError("expected integer in varList");
+        }
+        n->tokenSlot(2) = tk;    // integer
+        getNextToken();
+
+        link = &n->childSlot(1);
     }
-    n->tk2 = tk;    // integer
-    getNextToken();
+    return head;
+}
 
-    n->child1 = varList();
+// <block> -> { <vars> <stats> }
+// The program's own block, whose statements are streamed in streaming
+// mode; nested blocks are parsed by stat()
+Node* Parser::block() {
+    Node* n = openBlock();
+    n->childSlot(2) = onStatement ? streamStats() : stats();
+    closeBlock(n);
     return n;
 }
 
-// <block> -> { <vars> <stats> }
-static Node* block() {
+// { <vars>
+Node* Parser::openBlock() {
     Node* n = createNode(NodeType::BLOCK);
 
-    if (!isOp(tk, "{")) {
+    if (tk.kind != TokenKind::LBRACE_tk) {
         parseError("expected '{' to start block");
     }
-    n->tk1 = tk;
+    n->tokenSlot(1) = tk;
+    act<NodeType::BLOCK>(n);
     getNextToken();
 
-    n->child1 = vars();
-    n->child2 = stats();
+    n->childSlot(1) = vars();
+    return n;
+}
 
-    if (!isOp(tk, "}")) {
+// }
+void Parser::closeBlock(Node* n) {
+    if (tk.kind != TokenKind::RBRACE_tk) {
         parseError("expected '}' to end block");
     }
-    n->tk2 = tk;
+    n->tokenSlot(2) = tk;
+    actLeave<NodeType::BLOCK>(n);
     getNextToken();
-
-    return n;
 }
 
 // <stats> -> <stat> <mStat>
-static Node* stats() {
+Node* Parser::stats() {
     Node* n = createNode(NodeType::STATS);
-    n->child1 = stat();
-    n->child2 = mStat();
+    n->childSlot(1) = stat();
+    n->childSlot(2) = mStat();
     return n;
 }
 
+// FIRST(stat) = { read, print, {, if, while, set }
+static bool startsStat(TokenKind k) {
+    switch (k) {
+        case TokenKind::READ_tk:
+        case TokenKind::PRINT_tk:
+        case TokenKind::LBRACE_tk:
+        case TokenKind::IF_tk:
+        case TokenKind::WHILE_tk:
+        case TokenKind::SET_tk:
+            return true;
+        default:
+            return false;
+    }
+}
+
 // <mStat> -> empty | <stat> <mStat>
-static Node* mStat() {
-    // FIRST(stat) = { read, print, {, if, while, set }
-    if (isKw(tk, "read") || isKw(tk, "print") ||
-        isOp(tk, "{")     || isKw(tk, "if")    ||
-        isKw(tk, "while") || isKw(tk, "set")) {
+// Built iteratively: one MSTAT per statement, linked through child2,
+// so statement count never turns into recursion depth.
+Node* Parser::mStat() {
+    Node* head = nullptr;   // epsilon
+    Node** link = &head;
 
+    while (startsStat(tk.kind)) {
         Node* n = createNode(NodeType::MSTAT);
-        n->child1 = stat();
-        n->child2 = mStat();
-        return n;
+        *link = n;
+        n->childSlot(1) = stat();
+        link = &n->childSlot(2);
     }
-    return nullptr; // epsilon
+    return head;
+}
+
+// <stats> in streaming mode: each statement goes to onStatement as soon
+// as it is parsed and its nodes are freed after, so nothing is linked
+// into the tree and the arena never holds more than one statement.
+Node* Parser::streamStats() {
+    Arena::Mark mark = cx.nodes.mark();
+    do {
+        (*onStatement)(stat());
+        cx.nodes.releaseTo(mark);
+    } while (startsStat(tk.kind));
+    return nullptr;
 }
 
 // <stat> -> <read> | <print> | <block> | <cond> | <loop> | <assign>
-static Node* stat() {
-    Node* n = createNode(NodeType::STAT);
-
-    if (isKw(tk, "read")) {
-        n->child1 = readStmt();
-    } else if (isKw(tk, "print")) {
-        n->child1 = printStmt();
-    } else if (isOp(tk, "{")) {
-        n->child1 = block();
-    } else if (isKw(tk, "if")) {
-        n->child1 = cond();
-    } else if (isKw(tk, "while")) {
-        n->child1 = loopStmt();
-    } else if (isKw(tk, "set")) {
-        n->child1 = assign();
-    } else {
-        parseError("expected a statement (read/print/{/if/while/set)");
-    }
+// One loop iteration per statement, nested ones included. An if/while
+// body is simply the next statement, parsed into the node's child3. A
+// block is pushed on `blocks`; when a statement ends, the blocks it
+// closes are popped, or the block still open gets an MSTAT for the
+// next one (the STATS/MSTAT shape stats() and mStat() build).
+Node* Parser::stat() {
+    std::size_t base = blocks.size();
+    Node* head = nullptr;
+    Node** at = &head;      // where the statement being parsed goes
+
+    for (;;) {
+        Node* n = createNode(NodeType::STAT);
+        *at = n;
+
+        switch (tk.kind) {
+            case TokenKind::READ_tk:   n->childSlot(1) = readStmt();  break;
+            case TokenKind::PRINT_tk:  n->childSlot(1) = printStmt(); break;
+            case TokenKind::SET_tk:    n->childSlot(1) = assign();    break;
+            case TokenKind::IF_tk:
+                n->childSlot(1) = cond();
+                at = &n->child1()->childSlot(3);
+                continue;
+            case TokenKind::WHILE_tk:
+                n->childSlot(1) = loopStmt();
+                at = &n->child1()->childSlot(3);
+                continue;
+            case TokenKind::LBRACE_tk: {
+                Node* b = openBlock();
+                Node* list = createNode(NodeType::STATS);
+                n->childSlot(1) = b;
+                b->childSlot(2) = list;
+                blocks.push_back(OpenBlock{b, &list->childSlot(2)});
+                at = &list->childSlot(1);
+                continue;
+            }
+            default:
+                parseError("expected a statement (read/print/{/if/while/set)");
+        }
 
-    return n;
+        // a simple statement ended: close blocks until one continues
+        for (;;) {
+            if (blocks.size() == base) return head;
+            OpenBlock& open = blocks.back();
+            if (startsStat(tk.kind)) {
+                Node* m = createNode(NodeType::MSTAT);
+                *open.next = m;
+                open.next = &m->childSlot(2);
+                at = &m->childSlot(1);
+                break;
+            }
+            closeBlock(open.block);
+            blocks.pop_back();
+        }
+    }
 }
 
 // <read> -> read identifier :
-static Node* readStmt() {
+Node* Parser::readStmt() {
     Node* n = createNode(NodeType::READ);
 
-    n->tk1 = tk; // 'read'
+    n->tokenSlot(1) = tk; // 'read'
     getNextToken();
 
     if (!isId(tk)) {
         parseError("expected identifier after 'read'");
     }
-    n->tk2 = tk; // identifier
+    n->tokenSlot(2) = tk; // identifier
+    act<NodeType::READ>(n);
     getNextToken();
 
-    if (!isOp(tk, ":")) {
+    if (tk.kind != TokenKind::COLON_tk) {
         parseError("expected ':' after read statement");
     }
     getNextToken();
@@ -241,15 +388,15 @@ static Node* readStmt() {
 }
 
 // <print> -> print <exp> :
-static Node* printStmt() {
+Node* Parser::printStmt() {
     Node* n = createNode(NodeType::PRINT);
 
-    n->tk1 = tk; // 'print'
+    n->tokenSlot(1) = tk; // 'print'
     getNextToken();
 
-    n->child1 = exp();
+    n->childSlot(1) = exp();
 
-    if (!isOp(tk, ":")) {
+    if (tk.kind != TokenKind::COLON_tk) {
         parseError("expected ':' after print statement");
     }
     getNextToken();
@@ -258,13 +405,14 @@ static Node* printStmt() {
 }
 
 // <cond> -> if [ identifier <relational> <exp> ] <stat>
-static Node* cond() {
+// The <stat> is left to stat()
+Node* Parser::cond() {
     Node* n = createNode(NodeType::COND);
 
-    n->tk1 = tk; // 'if'
+    n->tokenSlot(1) = tk; // 'if'
     getNextToken();
 
-    if (!isOp(tk, "[")) {
+    if (tk.kind != TokenKind::LBRACKET_tk) {
         parseError("expected '[' after 'if'");
     }
     getNextToken();
@@ -272,29 +420,30 @@ static Node* cond() {
     if (!isId(tk)) {
         parseError("expected identifier in condition");
     }
-    n->tk2 = tk; // identifier
+    n->tokenSlot(2) = tk; // identifier
+    act<NodeType::COND>(n);
     getNextToken();
 
-    n->child1 = relational();
-    n->child2 = exp();
+    n->childSlot(1) = relational();
+    n->childSlot(2) = exp();
 
-    if (!isOp(tk, "]")) {
+    if (tk.kind != TokenKind::RBRACKET_tk) {
         parseError("expected ']' at end of condition");
     }
     getNextToken();
 
-    n->child3 = stat();
     return n;
 }
 
 // <loop> -> while [ identifier <relational> <exp> ] <stat>
-static Node* loopStmt() {
+// The <stat> is left to stat()
+Node* Parser::loopStmt() {
     Node* n = createNode(NodeType::LOOP);
 
-    n->tk1 = tk; // 'while'
+    n->tokenSlot(1) = tk; // 'while'
     getNextToken();
 
-    if (!isOp(tk, "[")) {
+    if (tk.kind != TokenKind::LBRACKET_tk) {
         parseError("expected '[' after 'while'");
     }
     getNextToken();
@@ -302,42 +451,43 @@ static Node* loopStmt() {
     if (!isId(tk)) {
         parseError("expected identifier in while condition");
     }
-    n->tk2 = tk;
+    n->tokenSlot(2) = tk;
+    act<NodeType::LOOP>(n);
     getNextToken();
 
-    n->child1 = relational();
-    n->child2 = exp();
+    n->childSlot(1) = relational();
+    n->childSlot(2) = exp();
 
-    if (!isOp(tk, "]")) {
+    if (tk.kind != TokenKind::RBRACKET_tk) {
         parseError("expected ']' at end of while condition");
     }
     getNextToken();
 
-    n->child3 = stat();
     return n;
 }
 
 // <assign> -> set identifier ~ <exp> :
-static Node* assign() {
+Node* Parser::assign() {
     Node* n = createNode(NodeType::ASSIGN);
 
-    n->tk1 = tk; // 'set'
+    n->tokenSlot(1) = tk; // 'set'
     getNextToken();
 
     if (!isId(tk)) {
         parseError("expected identifier in assignment");
     }
-    n->tk2 = tk; // identifier
+    n->tokenSlot(2) = tk; // identifier
+    act<NodeType::ASSIGN>(n);
     getNextToken();
 
-    if (!isOp(tk, "~")) {
+    if (tk.kind != TokenKind::TILDE_tk) {
         parseError("expected '~' in assignment");
     }
     getNextToken();
 
-    n->child1 = exp();
+    n->childSlot(1) = exp();
 
-    if (!isOp(tk, ":")) {
+    if (tk.kind != TokenKind::COLON_tk) {
         parseError("expected ':' after assignment");
     }
     getNextToken();
@@ -346,93 +496,121 @@ static Node* assign() {
 }
 
 // <relational> -> >  | >= | < | <= | eq | neq
-static Node* relational() {
+Node* Parser::relational() {
     Node* n = createNode(NodeType::REL);
 
-    if (isOp(tk, ">") || isOp(tk, ">=") ||
-        isOp(tk, "<") || isOp(tk, "<=") ||
-        isOp(tk, "eq") || isOp(tk, "neq")) {
-
-        n->tk1 = tk;
-        getNextToken();
-    } else {
-        parseError("expected relational operator (>,>=,<,<=,eq,neq)");
+    switch (tk.kind) {
+        case TokenKind::GT_tk:
+        case TokenKind::GE_tk:
+        case TokenKind::LT_tk:
+        case TokenKind::LE_tk:
+        case TokenKind::EQ_tk:
+        case TokenKind::NEQ_tk:
+            n->tokenSlot(1) = tk;
+            getNextToken();
+            break;
+        default:
+            parseError("expected relational operator (>,>=,<,<=,eq,neq)");
     }
     return n;
 }
 
+// The expression rules are right-recursive; each operator appends to
+// a right spine, so operator count never turns into recursion depth.
+// The spines are built in one loop: descend from the current level to
+// an R, then climb back attaching the operator that follows. A '(' R
+// saves the nodes reached so far on `parens` and starts a new <exp> in
+// its child1; its ')' restores them.
+//
 // <exp> -> <M> + <exp> | <M> - <exp> | <M>
-static Node* exp() {
-    Node* n = createNode(NodeType::EXP);
-
-    n->child1 = M();
-
-    if (isOp(tk, "+") || isOp(tk, "-")) {
-        n->tk1 = tk; // store + or -
-        getNextToken();
-        n->child2 = exp();
-    }
-
-    return n;
-}
-
-// <M> -> <N> * <M> | <N>
-static Node* M() {
-    Node* n = createNode(NodeType::M);
-
-    n->child1 = N();
-
-    if (isOp(tk, "*")) {
-        n->tk1 = tk; // '*'
-        getNextToken();
-        n->child2 = M();
-    }
-
-    return n;
-}
-
-// <N> -> <R> % <N> | - <N> | <R>
-static Node* N() {
-    Node* n = createNode(NodeType::N);
-
-    if (isOp(tk, "-")) {
-        n->tk1 = tk; // unary -
-        getNextToken();
-        n->child1 = N();
-    } else {
-        n->child1 = R();
-        if (isOp(tk, "%")) {
-            n->tk2 = tk; // '%'
+// <M>   -> <N> * <M> | <N>
+// <N>   -> <R> % <N> | - <N> | <R>
+// <R>   -> ( <exp> ) | identifier | integer
+Node* Parser::exp() {
+    std::size_t base = parens.size();
+    Node* head = nullptr;
+    Node** at = &head;                  // where the next node goes
+    NodeType from = NodeType::EXP;      // and its type
+    Node* e = nullptr;
+    Node* m = nullptr;
+    Node* n = nullptr;
+
+    for (;;) {
+        if (from == NodeType::EXP) {
+            e = createNode(NodeType::EXP);
+            *at = e;
+            at = &e->childSlot(1);
+        }
+        if (from != NodeType::N) {
+            m = createNode(NodeType::M);
+            *at = m;
+            at = &m->childSlot(1);
+        }
+        n = createNode(NodeType::N);
+        *at = n;
+        while (tk.kind == TokenKind::MINUS_tk) {
+            n->tokenSlot(1) = tk; // unary -
             getNextToken();
-            n->child2 = N();
+            Node* operand = createNode(NodeType::N);
+            n->childSlot(1) = operand;
+            n = operand;
         }
-    }
-
-    return n;
-}
 
-// <R> -> ( <exp> ) | identifier | integer
-static Node* R() {
-    Node* n = createNode(NodeType::R);
+        Node* r = createNode(NodeType::R);
+        n->childSlot(1) = r;
+        if (tk.kind == TokenKind::LPAREN_tk) {
+            r->tokenSlot(1) = tk; // '('
+            getNextToken();
+            parens.push_back(OpenParen{e, m, n, r});
+            at = &r->childSlot(1);
+            from = NodeType::EXP;
+            continue;
+        } else if (isId(tk)) {
+            r->tokenSlot(1) = tk; // identifier
+            act<NodeType::R>(r);
+            getNextToken();
+        } else if (isNum(tk)) {
+            r->tokenSlot(1) = tk; // integer
+            getNextToken();
+        } else {
+            parseError("expected '(', identifier, or integer in <R>");
+        }
 
-    if (isOp(tk, "(")) {
-        n->tk1 = tk; // '('
-        getNextToken();
-        n->child1 = exp();
-        if (!isOp(tk, ")")) {
-            parseError("expected ')' after expression");
+        // climb: the innermost level with an operator continues
+        for (;;) {
+            if (tk.kind == TokenKind::PERCENT_tk) {
+                n->tokenSlot(2) = tk; // '%'
+                getNextToken();
+                at = &n->childSlot(2);
+                from = NodeType::N;
+                break;
+            }
+            if (tk.kind == TokenKind::STAR_tk) {
+                m->tokenSlot(1) = tk; // '*'
+                getNextToken();
+                at = &m->childSlot(2);
+                from = NodeType::M;
+                break;
+            }
+            if (tk.kind == TokenKind::PLUS_tk || tk.kind == TokenKind::MINUS_tk) {
+                e->tokenSlot(1) = tk; // store + or -
+                getNextToken();
+                at = &e->childSlot(2);
+                from = NodeType::EXP;
+                break;
+            }
+            if (parens.size() == base) return head;
+
+            if (tk.kind != TokenKind::RPAREN_tk) {
+                parseError("expected ')' after expression");
+            }
+            OpenParen open = parens.back();
+            parens.pop_back();
+            open.r->tokenSlot(2) = tk; // ')'
+            getNextToken();
+            e = open.e;
+            m = open.m;
+            n = open.n;
         }
-        n->tk2 = tk; // ')'
-        getNextToken();
-    } else if (isId(tk)) {
-        n->tk1 = tk; // identifier
-        getNextToken();
-    } else if (isNum(tk)) {
-        n->tk1 = tk; // integer
-        getNextToken();
-    } else {
-        parseError("expected '(', identifier, or integer in <R>");
     }
-
-    return n;
 }
@@ -1,9 +1,28 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <functional>
 #include "node.h"
 
-// entry point for P2
-Node* parser();
+struct CompileContext;
+class SemanticsPass;
+class StorageCollector;
+
+// entry point for P2: parse cx's input into nodes from cx.nodes.
+// A syntax error is reported as "ERROR: ..." on cx.out and throws
+// CompileError.
+Node* parser(CompileContext& cx);
+
+// Single-pass mode: the passes get the same visit()/leave() calls
+// traverse() would make, as semantic actions at the point each
+// identifier is read, so no separate tree walk is needed and a P3 error
+// stops the parse at the offending token.
+Node* parser(CompileContext& cx, SemanticsPass& sem, StorageCollector& storage);
+
+// Streaming mode: single-pass, and each statement of the program's
+// outer block is handed to onStatement as soon as it is parsed, then
+// freed. The returned tree keeps the declarations but no statements.
+Node* parser(CompileContext& cx, SemanticsPass& sem, StorageCollector& storage,
+             const std::function<void(Node*)>& onStatement);
 
 #endif // PARSER_H
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "printTree.h"
 #include "token.h"
+#include "visitor.h"
 
 static const char* nodeLabel(NodeType t) {
     switch (t) {
@@ -44,23 +45,27 @@ static void emit(const Token& tk) {
     std::cout << " " << g << ":" << tk.instance << ":" << tk.line;
 }
 
-void printTree(Node* n, int depth) {
-    if (!n) return;
+// One line per node, indented by depth
+struct TreePrinter : TreePass {
+    int baseDepth;
+    explicit TreePrinter(int d) : baseDepth(d) {}
 
-    for (int i = 0; i < depth; ++i)
-        std::cout << "  ";
+    template <NodeType T>
+    void visit(NodeTag<T>, Node* n, int depth) {
+        for (int i = 0; i < baseDepth + depth; ++i)
+            std::cout << "  ";
 
-    std::cout << nodeLabel(n->label);
+        std::cout << nodeLabel(T);
 
-    emit(n->tk1);
-    emit(n->tk2);
-    emit(n->tk3);
+        emit(n->tk1());
+        emit(n->tk2());
+        emit(n->tk3());
 
-    std::cout << "\n";
+        std::cout << "\n";
+    }
+};
 
-    printTree(n->child1, depth + 1);
-    printTree(n->child2, depth + 1);
-    printTree(n->child3, depth + 1);
-    printTree(n->child4, depth + 1);
+void printTree(Node* n, int depth) {
+    TreePrinter p(depth);
+    traverse(n, p);
 }
-
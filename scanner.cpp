@@ -1,177 +1,571 @@
 // scanner.cpp
 #include "scanner.h"
-#include <cctype>
+#include "compiler.h"
+#include "intern.h"
+#include "simdScan.h"
+#include "source.h"
+#include "spscRing.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
-#include <iostream>
-#include <unordered_set>
+#include <functional>
+#include <ostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Everything private lives in an anonymous namespace
 namespace {
-    FILE* SRC = stdin;
-    int LINE = 1;
+    // Inputs at least this large are worth splitting across threads
+    const std::size_t PARALLEL_MIN_BYTES = 256 * 1024;
 
-    // Keywords per spec
-    const std::unordered_set<std::string> KEYWORDS = {
-        "start","trats","while","var","exit","read","print",
-        "if","then","set","func","program"
+    // ---------- character classes ----------
+
+    enum CharClass : std::uint8_t {
+        C_OTHER,      // anything that cannot start or continue a token
+        C_LETTER,     // a-z A-Z except the two below
+        C_LETTER_I,   // 'i' (identifier prefix)
+        C_LETTER_D,   // 'd' (identifier prefix)
+        C_UNDER,      // '_'
+        C_DIGIT,
+        C_LTGT,       // '<' '>' (may be followed by '=')
+        C_EQUALS,     // '=' (only valid after '<' or '>')
+        C_SINGLE,     // remaining single-char operators/delimiters
+        NUM_CLASSES
+    };
+
+    constexpr std::array<std::uint8_t, 256> makeClasses() {
+        std::array<std::uint8_t, 256> t{};
+        for (int c = 'a'; c <= 'z'; ++c) t[c] = C_LETTER;
+        for (int c = 'A'; c <= 'Z'; ++c) t[c] = C_LETTER;
+        for (int c = '0'; c <= '9'; ++c) t[c] = C_DIGIT;
+        t['i'] = C_LETTER_I;
+        t['d'] = C_LETTER_D;
+        t['_'] = C_UNDER;
+        t['<'] = C_LTGT;
+        t['>'] = C_LTGT;
+        t['='] = C_EQUALS;
+        for (char c : {'~',':',';','+','-','*','%','(',')','{','}','[',']'})
+            t[static_cast<unsigned char>(c)] = C_SINGLE;
+        return t;
+    }
+    constexpr std::array<std::uint8_t, 256> CLASS = makeClasses();
+
+    // ---------- token DFA ----------
+
+    // S_STOP means "the character does not extend the current token".
+    // S_OP1/S_OP2 accept as soon as they are entered.
+    enum State : std::uint8_t {
+        S_START,
+        S_WORD,       // letters that are not (yet) an identifier
+        S_I,          // "i"
+        S_ID,         // "id"
+        S_IDENT,      // "id_" followed by letters/digits
+        S_NUM,
+        S_LTGT,       // '<' or '>'
+        S_OP1,        // complete one-char operator
+        S_OP2,        // complete "<=" or ">="
+        NUM_STATES,
+        S_STOP = NUM_STATES
     };
 
-    // Single-char operators/delimiters
-    const std::unordered_set<char> SINGLE = {
-        '<','>','~',':',';','+','-','*','%','(',')','{','}','[',']'
+    using DfaTable = std::array<std::array<std::uint8_t, NUM_CLASSES>, NUM_STATES>;
+
+    constexpr DfaTable makeDfa() {
+        DfaTable t{};
+        for (auto& row : t)
+            for (auto& cell : row) cell = S_STOP;
+
+        t[S_START][C_LETTER]   = S_WORD;
+        t[S_START][C_LETTER_D] = S_WORD;
+        t[S_START][C_LETTER_I] = S_I;
+        t[S_START][C_DIGIT]    = S_NUM;
+        t[S_START][C_LTGT]     = S_LTGT;
+        t[S_START][C_SINGLE]   = S_OP1;
+
+        for (State s : {S_WORD, S_I, S_ID}) {
+            t[s][C_LETTER]   = S_WORD;
+            t[s][C_LETTER_I] = S_WORD;
+            t[s][C_LETTER_D] = S_WORD;
+        }
+        t[S_I][C_LETTER_D] = S_ID;
+        t[S_ID][C_UNDER]   = S_IDENT;
+
+        t[S_IDENT][C_LETTER]   = S_IDENT;
+        t[S_IDENT][C_LETTER_I] = S_IDENT;
+        t[S_IDENT][C_LETTER_D] = S_IDENT;
+        t[S_IDENT][C_DIGIT]    = S_IDENT;
+
+        t[S_NUM][C_DIGIT] = S_NUM;
+
+        t[S_LTGT][C_EQUALS] = S_OP2;
+        return t;
+    }
+    constexpr DfaTable DFA = makeDfa();
+
+    // Longest lexeme each state may reach before the limit action kicks in
+    // (words stop growing at 33 letters and are then rejected as a whole)
+    constexpr std::array<int, NUM_STATES> MAX_LEN = {
+        /*START*/ 0, /*WORD*/ 32, /*I*/ 32, /*ID*/ 32, /*IDENT*/ 8,
+        /*NUM*/ 8, /*LTGT*/ 1, /*OP1*/ 1, /*OP2*/ 2
+    };
+
+    // ---------- keyword perfect hash ----------
+
+    // Keywords per spec, plus the alphabetic operators eq/neq.
+    // (len + 3*first) mod 32 is collision-free over this fixed set.
+    struct WordEntry {
+        std::string_view word;
+        TokenKind kind;
+    };
+
+    constexpr std::size_t WORD_SLOTS = 32;
+
+    constexpr std::size_t wordHash(std::string_view w) {
+        return (w.size() + 3u * static_cast<unsigned char>(w[0])) & (WORD_SLOTS - 1);
+    }
+
+    constexpr WordEntry WORDS_IN[] = {
+        {"start", TokenKind::START_tk}, {"trats", TokenKind::TRATS_tk},
+        {"while", TokenKind::WHILE_tk}, {"var", TokenKind::VAR_tk},
+        {"exit", TokenKind::EXIT_tk},   {"read", TokenKind::READ_tk},
+        {"print", TokenKind::PRINT_tk}, {"if", TokenKind::IF_tk},
+        {"then", TokenKind::THEN_tk},   {"set", TokenKind::SET_tk},
+        {"func", TokenKind::FUNC_tk},   {"program", TokenKind::PROGRAM_tk},
+        {"eq", TokenKind::EQ_tk},       {"neq", TokenKind::NEQ_tk}
     };
 
-    int peekc() {
-        int c = fgetc(SRC);
-        if (c != EOF) ungetc(c, SRC);
-        return c;
+    constexpr std::array<WordEntry, WORD_SLOTS> makeWordTable() {
+        std::array<WordEntry, WORD_SLOTS> t{};
+        for (auto& e : t) e = WordEntry{"", TokenKind::ERR_tk};
+        for (const auto& w : WORDS_IN) t[wordHash(w.word)] = w;
+        return t;
     }
-    int getc_and_track() {
-        int c = fgetc(SRC);
-        if (c == '\n') LINE++;
-        return c;
+    constexpr std::array<WordEntry, WORD_SLOTS> WORD_TABLE = makeWordTable();
+
+    constexpr bool wordHashIsPerfect() {
+        for (const auto& w : WORDS_IN)
+            if (WORD_TABLE[wordHash(w.word)].word != w.word) return false;
+        return true;
+    }
+    static_assert(wordHashIsPerfect(), "keyword hash collides; pick new constants");
+
+    // ERR_tk when `w` is not a keyword or eq/neq
+    TokenKind classifyWord(std::string_view w) {
+        const WordEntry& e = WORD_TABLE[wordHash(w)];
+        return e.word == w ? e.kind : TokenKind::ERR_tk;
     }
 
-    [[noreturn]] void lexError(const std::string& msg) {
-        std::cerr << "LEXICAL ERROR: " << msg << " at line " << LINE << '\n';
-        std::exit(EXIT_FAILURE);
+    // Kind of each one-character operator/delimiter (ERR_tk elsewhere)
+    constexpr std::array<TokenKind, 256> makeOpKinds() {
+        std::array<TokenKind, 256> t{};
+        for (auto& k : t) k = TokenKind::ERR_tk;
+        t['<'] = TokenKind::LT_tk;       t['>'] = TokenKind::GT_tk;
+        t['~'] = TokenKind::TILDE_tk;    t[':'] = TokenKind::COLON_tk;
+        t[';'] = TokenKind::SEMI_tk;     t['+'] = TokenKind::PLUS_tk;
+        t['-'] = TokenKind::MINUS_tk;    t['*'] = TokenKind::STAR_tk;
+        t['%'] = TokenKind::PERCENT_tk;  t['('] = TokenKind::LPAREN_tk;
+        t[')'] = TokenKind::RPAREN_tk;   t['{'] = TokenKind::LBRACE_tk;
+        t['}'] = TokenKind::RBRACE_tk;   t['['] = TokenKind::LBRACKET_tk;
+        t[']'] = TokenKind::RBRACKET_tk;
+        return t;
     }
+    constexpr std::array<TokenKind, 256> OP_KIND = makeOpKinds();
+
+    Token makeToken(TokenKind k, std::string_view text, int line) {
+        return Token{tokenGroup(k), k, text, line};
+    }
+
+    // ---------- lexer ----------
 
-    bool isLetter(int c){ return std::isalpha(c); }
-    bool isDigit(int c){ return std::isdigit(c); }
+    // Cursor over [cur, end). Several may run at once over disjoint
+    // ranges of the same buffer, so errors are recorded, not reported:
+    // next() returns an ERR_tk whose line is the error line and leaves
+    // the message in `error`.
+    struct Lexer {
+        const char* cur = nullptr;   // next unread byte
+        const char* end = nullptr;
+        int line = 1;
+        Interner* syms = nullptr;    // identifiers are interned here
+        std::string error;
 
-    void skipWhitespace() {
+        Token next();
+
+    private:
+        Token fail(const std::string& msg) {
+            error = msg;
+            return makeToken(TokenKind::ERR_tk, "", line);
+        }
+
+        // Lexeme from `start` up to the cursor (no copy)
+        std::string_view lexeme(const char* start) const {
+            return std::string_view(start, static_cast<std::size_t>(cur - start));
+        }
+
+        bool skipWhitespace();
+    };
+
+    // False on an unterminated comment
+    bool Lexer::skipWhitespace() {
         for (;;) {
-            int c = peekc();
-            if (c==' ' || c=='\t' || c=='\r' || c=='\n') { getc_and_track(); continue; }
+            cur = skipBlanks(cur, end, line);
+            if (cur == end || *cur != '#') return true;
+
             // #...# comment (same line per assignment simplification)
-            if (c == '#') {
-                getc_and_track(); // consume '#'
-                bool closed = false;
-                int d;
-                while ((d = getc_and_track()) != EOF) {
-                    if (d == '#') { closed = true; break; }
-                    if (d == '\n') break; // violates “same line” simplification
-                }
-                if (!closed) lexError("unterminated comment '#...#' on same line");
-                continue;
+            const char* close = findCommentEnd(cur + 1, end);
+            if (close == end || *close == '\n') {
+                // violates “same line” simplification; the newline is consumed
+                // before reporting, as the character-at-a-time scanner did
+                cur = close;
+                if (close != end) { ++cur; ++line; }
+                return false;
             }
-            break;
+            cur = close + 1;
         }
     }
 
-    // Try to read multi-char ops: eq, neq, <=, >=
-    bool tryMultiOp(Token& tk) {
-        int c = peekc();
-        if (c == EOF) return false;
+    Token Lexer::next() {
+        if (!skipWhitespace()) return fail("unterminated comment '#...#' on same line");
 
-        // alphabetic ops: eq, neq
-        if (std::isalpha(c)) {
-            std::string buf;
-            while (std::isalpha(peekc())) {
-                buf.push_back(static_cast<char>(getc_and_track()));
-                if (buf.size() > 3) break;
-            }
-            if (buf == "eq" || buf == "neq") {
-                tk.id = TokenID::OP_tk; tk.instance = buf; tk.line = LINE;
-                return true;
+        if (cur == end) return makeToken(TokenKind::EOF_tk, "", line);
+
+        // Run the DFA from the cursor. Tokens never contain '\n',
+        // so the line does not move here.
+        const char* start = cur;
+        State st = S_START;
+        while (cur != end) {
+            std::uint8_t next = DFA[st][CLASS[static_cast<unsigned char>(*cur)]];
+            if (next == S_STOP) break;
+            st = static_cast<State>(next);
+            ++cur;
+            if (cur - start > MAX_LEN[st]) {
+                if (st == S_IDENT) return fail("identifier length exceeds 8 characters");
+                if (st == S_NUM) return fail("integer length exceeds 8 digits");
+                break;
             }
-            // push back if not an op
-            for (int i = (int)buf.size()-1; i >= 0; --i) ungetc(buf[i], SRC);
-            return false;
+            if (st == S_OP1 || st == S_OP2) break;
         }
-        // <= or >=
-        if (c == '<' || c == '>') {
-            int first = getc_and_track();
-            if (peekc() == '=') {
-                getc_and_track();
-                tk.id = TokenID::OP_tk;
-                tk.instance = std::string(1, char(first)) + "=";
-                tk.line = LINE;
-                return true;
+
+        switch (st) {
+            case S_WORD:
+            case S_I:
+            case S_ID: {
+                std::string_view w = lexeme(start);
+                TokenKind k = classifyWord(w);
+                if (k == TokenKind::ERR_tk)
+                    return fail("invalid word token '" + std::string(w) + "'");
+                return makeToken(k, w, line);
             }
-            ungetc(first, SRC);
-            return false;
+            case S_IDENT: {
+                Token t = makeToken(TokenKind::IDENT_tk, lexeme(start), line);
+                t.sym = syms->intern(t.instance);
+                return t;
+            }
+            case S_NUM:
+                return makeToken(TokenKind::NUM_tk, lexeme(start), line);
+            case S_LTGT:
+            case S_OP1:
+                return makeToken(OP_KIND[static_cast<unsigned char>(*start)], lexeme(start), line);
+            case S_OP2:
+                return makeToken(*start == '<' ? TokenKind::LE_tk : TokenKind::GE_tk,
+                                 lexeme(start), line);
+            default:
+                break;
         }
-        return false;
+
+        // unknown character
+        std::string bad(1, *cur++);
+        return fail("unrecognized character '" + bad + "'");
     }
 
-    Token lexIdentifier() {
-        // must start with id_
-        // we've not consumed anything yet
-        int c1 = getc_and_track(); // should be 'i'
-        int c2 = peekc(); if (c2=='d') getc_and_track(); else lexError("identifier must start with 'id_'");
-        int c3 = peekc(); if (c3=='_') getc_and_track(); else lexError("identifier must start with 'id_'");
+    // ---------- parallel mode ----------
 
-        std::string buf = "id_";
-        while (isLetter(peekc()) || isDigit(peekc())) {
-            buf.push_back(static_cast<char>(getc_and_track()));
-            if ((int)buf.size() > 8) lexError("identifier length exceeds 8 characters");
+    // One newline-aligned slice of the input, lexed on its own thread.
+    // Lines are counted from 0 and identifiers interned into a private
+    // table inside the chunk; `lineBase` and `symMap` translate them to
+    // absolute lines and shared symbol IDs once all chunks are done.
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::vector<Token> tokens;   // ends in ERR_tk if lexing failed
+        std::string error;
+        int lines = 0;               // newlines consumed
+        int lineBase = 1;
+        Interner localSyms;
+        std::vector<int> symMap;     // local symbol ID -> shared ID
+    };
+
+    void lexChunk(Chunk& c) {
+        Lexer lx;
+        lx.cur = c.begin;
+        lx.end = c.end;
+        lx.line = 0;
+        lx.syms = &c.localSyms;
+        for (;;) {
+            Token t = lx.next();
+            if (t.id == TokenID::EOFTk) break;
+            c.tokens.push_back(t);
+            if (t.id == TokenID::ERR_tk) { c.error = lx.error; break; }
         }
-        return Token{TokenID::IDENT_tk, buf, LINE};
+        c.lines = lx.line;
     }
 
-    Token lexNumber() {
-        std::string buf;
-        while (isDigit(peekc())) {
-            buf.push_back(static_cast<char>(getc_and_track()));
-            if ((int)buf.size() > 8) lexError("integer length exceeds 8 digits");
+    // Comments end on their line and no token spans a newline, so the
+    // input can be cut after any '\n' and each piece lexed independently.
+    std::vector<Chunk> lexParallel(const char* begin, const char* end, unsigned parts,
+                                   Interner& syms) {
+        std::vector<Chunk> chunks;
+        auto addChunk = [&chunks](const char* from, const char* to) {
+            chunks.emplace_back();
+            chunks.back().begin = from;
+            chunks.back().end = to;
+        };
+        const std::size_t step = static_cast<std::size_t>(end - begin) / parts;
+        const char* from = begin;
+        for (unsigned i = 1; i < parts && from != end; ++i) {
+            const char* cut = begin + i * step;
+            if (cut < from) cut = from;
+            cut = static_cast<const char*>(std::memchr(cut, '\n', static_cast<std::size_t>(end - cut)));
+            if (!cut) break;
+            addChunk(from, cut + 1);
+            from = cut + 1;
         }
-        return Token{TokenID::NUM_tk, buf, LINE};
-    }
+        addChunk(from, end);
 
-    Token lexWordOrError() {
-        if (!std::isalpha(peekc())) lexError("unexpected non-letter where a word token was expected");
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < chunks.size(); ++i)
+            workers.emplace_back(lexChunk, std::ref(chunks[i]));
+        lexChunk(chunks[0]);
+        for (auto& w : workers) w.join();
 
-        // identifier prefix check
-        if (peekc() == 'i') {
-            int c1 = fgetc(SRC), c2 = fgetc(SRC), c3 = fgetc(SRC);
-            if (c3 != EOF) ungetc(c3, SRC);
-            if (c2 != EOF) ungetc(c2, SRC);
-            if (c1 != EOF) ungetc(c1, SRC);
-            if (c1=='i' && c2=='d' && c3=='_') return lexIdentifier();
+        // Visiting chunks in order hands out shared IDs in the same
+        // first-seen order a sequential scan would
+        int base = 1;
+        for (auto& c : chunks) {
+            c.lineBase = base;
+            base += c.lines;
+            for (int id = 0; id < c.localSyms.size(); ++id)
+                c.symMap.push_back(syms.intern(c.localSyms.name(id)));
         }
+        return chunks;
+    }
+
+    // ---------- pipelined mode ----------
+
+    // Tokens travel to the parser in batches, so the ring's atomics are
+    // touched once per batch rather than once per token.
+    const std::size_t BATCH_TOKENS = 512;
+    const std::size_t RING_BATCHES = 64;
+
+    struct TokenBatch {
+        Token tokens[BATCH_TOKENS];
+        std::size_t count;
+        std::string error;      // message for a trailing ERR_tk
+    };
+    using TokenRing = SpscRing<TokenBatch, RING_BATCHES>;
 
-        std::string w;
-        while (std::isalpha(peekc())) {
-            w.push_back(static_cast<char>(getc_and_track()));
-            if (w.size() > 32) break;
+    struct Pipeline {
+        std::unique_ptr<TokenRing> ring;
+        std::thread producer;
+        std::atomic<bool> stop{false};
+        std::atomic<std::size_t> producerStalls{0};
+
+        // consumer (parser thread) side
+        TokenBatch* batch = nullptr;    // batch being handed out
+        std::size_t next = 0;           // position in batch
+        bool drained = false;           // EOF already handed out
+        std::size_t batches = 0;
+        std::size_t occupancySum = 0;
+        std::size_t peak = 0;
+        std::size_t consumerStalls = 0;
+    };
+
+    // Producer thread: lex until EOF or the first error
+    void produce(Lexer lx, Pipeline& p) {
+        for (;;) {
+            TokenBatch* b = p.ring->slotToFill();
+            if (!b) {
+                p.producerStalls.fetch_add(1, std::memory_order_relaxed);
+                while (!(b = p.ring->slotToFill())) {
+                    if (p.stop.load(std::memory_order_relaxed)) return;
+                    std::this_thread::yield();
+                }
+            }
+
+            bool done = false;
+            b->count = 0;
+            while (!done && b->count < BATCH_TOKENS) {
+                Token t = lx.next();
+                b->tokens[b->count++] = t;
+                if (t.id == TokenID::ERR_tk) b->error = lx.error;
+                done = (t.id == TokenID::ERR_tk || t.id == TokenID::EOFTk);
+            }
+            p.ring->publish();
+            if (done) return;
         }
-        if (KEYWORDS.count(w)) return Token{TokenID::KW_tk, w, LINE};
-        if (w == "eq" || w == "neq") return Token{TokenID::OP_tk, w, LINE};
-        lexError(std::string("invalid word token '") + w + "'");
     }
+
 } // end anonymous namespace
 
-void initScanner(FILE* in) {
-    SRC = in ? in : stdin;
-    LINE = 1;
-}
+// ---------- scanner state ----------
 
-Token scanner() {
-    skipWhitespace();
+struct Scanner::State {
+    SourceBuffer src;             // whole input, mapped or read once
+    Lexer main;                   // on-demand lexer (Direct mode)
+    std::ostream* diag = nullptr;
 
-    int c = peekc();
-    if (c == EOF) return Token{TokenID::EOFTk, "", LINE};
+    ScanMode mode = ScanMode::Direct;
+    std::vector<Chunk> chunks;    // pre-lexed stream (Parallel mode)
+    std::size_t chunk = 0;        // position in chunks
+    std::size_t next = 0;         // position in chunks[chunk].tokens
+    int eofLine = 1;
+    Pipeline pipe;                // token ring (Pipelined mode)
+    std::size_t handedOut = 0;    // tokens returned by next()
 
-    Token tk{TokenID::ERR_tk, "", LINE};
+    [[noreturn]] void lexError(const std::string& msg, int line) {
+        *diag << "LEXICAL ERROR: " << msg << " at line " << line << '\n';
+        throw CompileError{};
+    }
 
-    // multi-char ops first
-    if (tryMultiOp(tk)) return tk;
+    // Also runs on destruction, so the producer never outlives src
+    void stopPipeline() {
+        if (pipe.producer.joinable()) {
+            pipe.stop.store(true, std::memory_order_relaxed);
+            pipe.producer.join();
+        }
+    }
+
+    void startPipeline() {
+        if (!pipe.ring) pipe.ring = std::make_unique<TokenRing>();
+        pipe.stop.store(false);
+        pipe.producer = std::thread(produce, main, std::ref(pipe));
+    }
 
-    c = peekc();
-    if (c == EOF) return Token{TokenID::EOFTk, "", LINE};
+    Token nextPiped() {
+        Pipeline& p = pipe;
+        if (p.drained) return makeToken(TokenKind::EOF_tk, "", eofLine);
 
-    if (std::isdigit(c)) return lexNumber();
-    if (std::isalpha(c)) return lexWordOrError();
+        if (!p.batch) {
+            if (!(p.batch = p.ring->front())) {
+                p.consumerStalls++;
+                while (!(p.batch = p.ring->front())) std::this_thread::yield();
+            }
+            std::size_t queued = p.ring->size();
+            p.batches++;
+            p.occupancySum += queued;
+            if (queued > p.peak) p.peak = queued;
+            p.next = 0;
+        }
 
-    if (SINGLE.count(static_cast<char>(c))) {
-        getc_and_track();
-        return Token{TokenID::OP_tk, std::string(1, static_cast<char>(c)), LINE};
+        Token t = p.batch->tokens[p.next++];
+        if (t.id == TokenID::ERR_tk) lexError(p.batch->error, t.line);
+        if (t.id == TokenID::EOFTk) {
+            p.drained = true;
+            eofLine = t.line;
+        }
+        if (p.next == p.batch->count) {
+            p.ring->pop();
+            p.batch = nullptr;
+        }
+        return t;
+    }
+
+    ~State() { stopPipeline(); }
+};
+
+Scanner::Scanner() : st(std::make_unique<State>()) {}
+Scanner::~Scanner() = default;
+
+void Scanner::open(FILE* in, Interner& syms, std::ostream& diag, ScanMode mode) {
+    State& s = *st;
+    s.stopPipeline();
+    s.diag = &diag;
+    Pipeline& pipe = s.pipe;
+    pipe.batch = nullptr;
+    pipe.next = 0;
+    pipe.drained = false;
+    pipe.batches = pipe.occupancySum = pipe.peak = pipe.consumerStalls = 0;
+    pipe.producerStalls = 0;
+    pipe.ring.reset();
+
+    s.chunks.clear();
+    s.chunk = s.next = 0;
+    s.handedOut = 0;
+
+    if (!s.src.load(in ? in : stdin)) {
+        diag << "ERROR: cannot read input\n";
+        throw CompileError{};
+    }
+    s.main = Lexer{};
+    s.main.cur = s.src.begin();
+    s.main.end = s.src.end();
+    s.main.line = 1;
+    s.main.syms = &syms;
+    syms.clear();
+
+    unsigned cores = std::thread::hardware_concurrency();
+    s.mode = mode;
+    if (mode == ScanMode::Parallel && (s.src.size < PARALLEL_MIN_BYTES || cores < 2))
+        s.mode = ScanMode::Direct;
+
+    if (s.mode == ScanMode::Parallel) {
+        s.chunks = lexParallel(s.src.begin(), s.src.end(), cores, syms);
+        s.eofLine = s.chunks.back().lineBase + s.chunks.back().lines;
     }
+    if (s.mode == ScanMode::Pipelined) s.startPipeline();
+}
+
+void Scanner::close() {
+    State& s = *st;
+    s.stopPipeline();
+    s.pipe.batch = nullptr;
+    s.pipe.ring.reset();
+    s.chunks.clear();
+    s.src.release();
+    s.main.cur = s.main.end = nullptr;
+}
+
+Token Scanner::next() {
+    State& s = *st;
+    ++s.handedOut;
+    if (s.mode == ScanMode::Direct) {
+        Token t = s.main.next();
+        if (t.id == TokenID::ERR_tk) s.lexError(s.main.error, t.line);
+        return t;
+    }
+    if (s.mode == ScanMode::Pipelined) return s.nextPiped();
+
+    while (s.chunk < s.chunks.size() && s.next == s.chunks[s.chunk].tokens.size()) {
+        ++s.chunk;
+        s.next = 0;
+    }
+    if (s.chunk == s.chunks.size()) return makeToken(TokenKind::EOF_tk, "", s.eofLine);
+
+    const Chunk& c = s.chunks[s.chunk];
+    Token t = c.tokens[s.next++];
+    t.line += c.lineBase;
+    if (t.sym >= 0) t.sym = c.symMap[static_cast<std::size_t>(t.sym)];
+    // the earliest failing chunk stops the stream; later chunks are never read
+    if (t.id == TokenID::ERR_tk) s.lexError(c.error, t.line);
+    return t;
+}
+
+std::size_t Scanner::tokenCount() const {
+    return st->handedOut;
+}
 
-    // unknown character
-    std::string bad(1, static_cast<char>(getc_and_track()));
-    lexError(std::string("unrecognized character '") + bad + "'");
+PipelineStats Scanner::pipelineStats() const {
+    const Pipeline& pipe = st->pipe;
+    PipelineStats ps{};
+    ps.capacity = RING_BATCHES;
+    ps.batchTokens = BATCH_TOKENS;
+    ps.batches = pipe.batches;
+    ps.peakOccupancy = pipe.peak;
+    ps.meanOccupancy = pipe.batches ? double(pipe.occupancySum) / double(pipe.batches) : 0.0;
+    ps.producerStalls = pipe.producerStalls.load(std::memory_order_relaxed);
+    ps.consumerStalls = pipe.consumerStalls;
+    return ps;
 }
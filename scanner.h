@@ -1,19 +1,78 @@
 #ifndef SCANNER_H
 #define SCANNER_H
+#include <cstddef>
 #include <cstdio>
+#include <iosfwd>
+#include <memory>
 #include "token.h"
 
+class Interner;
 
-// Initialize scanner with an input FILE* (defaults to stdin if nullptr)
-void initScanner(FILE* in);
 
+// How Scanner::next() produces its tokens
+enum class ScanMode {
+    Direct,     // lex one token per call
+    Parallel,   // lex newline-aligned chunks on all cores up front
+                // (small inputs and single-core hosts fall back to Direct)
+    Pipelined   // lex on a producer thread, feeding the parser through
+                // a bounded lock-free ring of token batches
+};
 
-// Get next token (one at a time)
-Token scanner();
 
+// Queue usage of the last Pipelined run (zeros for other modes).
+// Occupancy is sampled each time the parser takes a batch.
+struct PipelineStats {
+    std::size_t capacity;         // ring slots (batches)
+    std::size_t batchTokens;      // tokens per batch
+    std::size_t batches;          // batches handed to the parser
+    std::size_t peakOccupancy;    // most batches queued at a sample
+    double meanOccupancy;
+    std::size_t producerStalls;   // times the scanner found the ring full
+    std::size_t consumerStalls;   // times the parser found it empty
+};
 
-// Tester: repeatedly call scanner() and print tokens per spec
-int testScanner();
+
+// The scanner of one compilation. Each instance owns its input and
+// lexing state, so independent compilations can scan concurrently.
+class Scanner {
+public:
+    Scanner();
+    ~Scanner();   // stops a Pipelined producer before the input goes away
+    Scanner(const Scanner&) = delete;
+    Scanner& operator=(const Scanner&) = delete;
+
+    // Load the whole input from `in` (stdin if nullptr) and start lexing
+    // it in place. Identifiers are interned into `syms`, which is
+    // cleared first; each token carries a copy of its (at most
+    // 8-character) lexeme. Errors are written to `diag` followed by a
+    // CompileError; that includes an unreadable input here.
+    void open(FILE* in, Interner& syms, std::ostream& diag, ScanMode mode = ScanMode::Direct);
+
+    // Next token (one at a time); "LEXICAL ERROR: ..." on bad input
+    Token next();
+
+    // Stop a Pipelined producer and let go of the input. Called when a
+    // compilation ends, however it ends, so a context kept for reuse
+    // (batch workers, the server) holds no thread or mapping between
+    // compiles. tokenCount() and pipelineStats() stay readable.
+    void close();
+
+    // Tokens handed out since open()
+    std::size_t tokenCount() const;
+
+    PipelineStats pipelineStats() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> st;
+};
+
+
+// Lexer throughput benchmark (compile --bench-lex): lex <fileBase>.fs25s2,
+// or an 8 MiB synthetic program when fileBase is nullptr, repeatedly in
+// the given mode and print tokens/sec, MB/sec, allocations per pass and
+// per-kind token counts. Returns the process exit status.
+int testScanner(const char* fileBase, ScanMode mode);
 
 
 #endif // SCANNER_H
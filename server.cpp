@@ -0,0 +1,363 @@
+// server.cpp (compile server and client over a Unix domain socket)
+#include "server.h"
+#include "cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    const char* EXT = ".fs25s2";
+
+    // ---------- socket helpers ----------
+
+    bool makeAddress(const char* path, sockaddr_un& addr) {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (std::strlen(path) >= sizeof(addr.sun_path)) return false;
+        std::strcpy(addr.sun_path, path);
+        return true;
+    }
+
+    bool sendAll(int fd, const std::string& data) {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            // MSG_NOSIGNAL: a client that hung up must not kill the server
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    // Read one '\n'-terminated line (without the '\n'); false on EOF/error
+    bool readLine(int fd, std::string& line) {
+        line.clear();
+        char c;
+        for (;;) {
+            ssize_t n = ::read(fd, &c, 1);
+            if (n <= 0) return false;
+            if (c == '\n') return true;
+            line += c;
+        }
+    }
+
+    std::string readAll(int fd) {
+        std::string data;
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) data.append(buf, static_cast<std::size_t>(n));
+        return data;
+    }
+
+    // ---------- latency record ----------
+
+    // Request latencies in a fixed histogram of log-spaced buckets, 16
+    // per power of two, so a server that runs for months keeps constant
+    // memory and STATS costs the same at any request count. Count, mean
+    // and max are exact; a percentile is its bucket's geometric middle,
+    // within about 2% of the true value.
+    class Latencies {
+    public:
+        void add(double micros) {
+            std::lock_guard<std::mutex> g(lock);
+            buckets[bucketOf(micros)]++;
+            count++;
+            sum += micros;
+            if (micros > max) max = micros;
+        }
+
+        std::string report() {
+            std::vector<std::uint64_t> b;
+            std::uint64_t n;
+            double total, most;
+            {
+                std::lock_guard<std::mutex> g(lock);
+                b.assign(buckets, buckets + BUCKETS);
+                n = count;
+                total = sum;
+                most = max;
+            }
+            std::ostringstream os;
+            os << "requests " << n << '\n';
+            if (!n) return os.str();
+
+            auto pct = [&](double p) {
+                std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(n - 1) + 0.5);
+                std::uint64_t seen = 0;
+                std::size_t i = 0;
+                while (seen + b[i] <= rank) seen += b[i++];
+                return std::min(middleOf(i), most);
+            };
+            os << std::fixed << std::setprecision(1)
+               << "latency_us mean " << total / static_cast<double>(n)
+               << " p50 " << pct(50) << " p90 " << pct(90)
+               << " p99 " << pct(99) << " max " << most << '\n';
+            return os.str();
+        }
+
+    private:
+        static const int PER_OCTAVE = 16;
+        static const std::size_t BUCKETS = 40 * PER_OCTAVE + 1;   // up to 2^40 us
+
+        // bucket 0 holds everything under 1 us
+        static std::size_t bucketOf(double micros) {
+            if (!(micros >= 1.0)) return 0;
+            double i = std::log2(micros) * PER_OCTAVE + 1.0;
+            return i >= static_cast<double>(BUCKETS - 1) ? BUCKETS - 1 : static_cast<std::size_t>(i);
+        }
+        static double middleOf(std::size_t i) {
+            return i ? std::exp2((static_cast<double>(i) - 0.5) / PER_OCTAVE) : 0.5;
+        }
+
+        std::mutex lock;
+        std::uint64_t buckets[BUCKETS] = {};   // COMPILE requests by latency
+        std::uint64_t count = 0;
+        double sum = 0.0;
+        double max = 0.0;
+    };
+
+    // ---------- server ----------
+
+    struct Server {
+        CompileOptions opts;
+        int listenFd = -1;
+        std::atomic<bool> stopping{false};
+        Latencies latencies;
+
+        // accepted connections waiting for a worker; -1 tells a worker to exit
+        std::mutex lock;
+        std::condition_variable ready;
+        std::deque<int> pending;
+
+        void push(int fd) {
+            {
+                std::lock_guard<std::mutex> g(lock);
+                pending.push_back(fd);
+            }
+            ready.notify_one();
+        }
+
+        int pop() {
+            std::unique_lock<std::mutex> g(lock);
+            ready.wait(g, [this] { return !pending.empty(); });
+            int fd = pending.front();
+            pending.pop_front();
+            return fd;
+        }
+
+        void worker() {
+            CompileContext cx(opts);
+            for (int fd; (fd = pop()) >= 0; ) {
+                handle(cx, fd);
+                ::close(fd);
+            }
+        }
+
+        void handle(CompileContext& cx, int fd) {
+            std::string cmd;
+            if (!readLine(fd, cmd)) return;
+
+            if (cmd == "COMPILE") {
+                auto t0 = std::chrono::steady_clock::now();
+                std::string inPath, outPath;
+                if (!readLine(fd, inPath) || !readLine(fd, outPath)) return;
+
+                cx.reset();
+                int status = compilePaths(cx, inPath, outPath);
+                std::string out = cx.out.str();
+                std::string err = cx.err.str();
+                std::ostringstream head;
+                head << status << ' ' << out.size() << ' ' << err.size() << '\n';
+                sendAll(fd, head.str() + out + err);
+
+                latencies.add(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - t0).count());
+            } else if (cmd == "STATS") {
+                std::ostringstream report;
+                report << latencies.report();
+                if (opts.cache) report << opts.cache->stats();
+                sendAll(fd, report.str());
+            } else if (cmd == "STOP") {
+                sendAll(fd, "OK\n");
+                stopping.store(true);
+                ::shutdown(listenFd, SHUT_RDWR);   // wakes the accept loop
+            } else {
+                sendAll(fd, "ERROR: unknown request '" + cmd + "'\n");
+            }
+        }
+    };
+
+    // ---------- client ----------
+
+    int connectTo(const char* socketPath) {
+        sockaddr_un addr;
+        if (!makeAddress(socketPath, addr)) {
+            std::cerr << "ERROR: socket path too long '" << socketPath << "'\n";
+            return -1;
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::cerr << "ERROR: cannot connect to compile server at '" << socketPath << "'\n";
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Send a request and collect the whole reply; false if the server is unreachable
+    bool request(const char* socketPath, const std::string& req, std::string& reply) {
+        int fd = connectTo(socketPath);
+        if (fd < 0) return false;
+        bool ok = sendAll(fd, req);
+        if (ok) reply = readAll(fd);
+        ::close(fd);
+        return ok;
+    }
+
+    // Make socketPath free for bind(). Only a socket file that nothing
+    // is listening on (left by a server that did not stop cleanly) is
+    // removed; a live server or any other file at the path is an error.
+    bool claimSocketPath(const char* socketPath, const sockaddr_un& addr) {
+        struct stat st;
+        if (::lstat(socketPath, &st) != 0) {
+            if (errno == ENOENT) return true;
+            std::cerr << "ERROR: cannot use '" << socketPath << "': " << std::strerror(errno) << '\n';
+            return false;
+        }
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "ERROR: '" << socketPath << "' exists and is not a socket\n";
+            return false;
+        }
+
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) {
+            std::cerr << "ERROR: cannot probe '" << socketPath << "': " << std::strerror(errno) << '\n';
+            return false;
+        }
+        bool live = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+        int probeErr = errno;
+        ::close(probe);
+        if (live) {
+            std::cerr << "ERROR: a compile server is already listening on '" << socketPath << "'\n";
+            return false;
+        }
+        if (probeErr != ECONNREFUSED) {
+            std::cerr << "ERROR: cannot probe '" << socketPath << "': " << std::strerror(probeErr) << '\n';
+            return false;
+        }
+        if (::unlink(socketPath) != 0 && errno != ENOENT) {
+            std::cerr << "ERROR: cannot remove stale socket '" << socketPath << "': "
+                      << std::strerror(errno) << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    std::string absolute(const std::string& path) {
+        if (!path.empty() && path[0] == '/') return path;
+        char cwd[4096];
+        if (!::getcwd(cwd, sizeof(cwd))) return path;
+        return std::string(cwd) + "/" + path;
+    }
+} // end anonymous namespace
+
+int serve(const char* socketPath, const CompileOptions& opts, unsigned jobs) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr)) {
+        std::cerr << "ERROR: socket path too long '" << socketPath << "'\n";
+        return 1;
+    }
+
+    if (!claimSocketPath(socketPath, addr)) return 1;
+
+    Server server;
+    server.opts = opts;
+    server.listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server.listenFd < 0 ||
+        ::bind(server.listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(server.listenFd, 128) < 0) {
+        std::cerr << "ERROR: cannot listen on '" << socketPath << "': " << std::strerror(errno) << '\n';
+        if (server.listenFd >= 0) ::close(server.listenFd);
+        return 1;
+    }
+
+    if (!jobs) jobs = std::thread::hardware_concurrency();
+    if (!jobs) jobs = 1;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < jobs; ++i)
+        workers.emplace_back(&Server::worker, &server);
+
+    // Only STOP ends the loop (it shuts the listening socket down, so
+    // accept() fails once `stopping` is set). Other failures are
+    // transient: out of descriptors or buffers, or a client that gave
+    // up while queued.
+    while (!server.stopping.load()) {
+        int fd = ::accept(server.listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            int e = errno;
+            if (server.stopping.load()) break;
+            if (e == EINTR) continue;
+            std::cerr << "WARNING: accept on '" << socketPath << "' failed: " << std::strerror(e) << '\n';
+            if (e == EMFILE || e == ENFILE || e == ENOBUFS || e == ENOMEM)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        server.push(fd);
+    }
+
+    for (unsigned i = 0; i < jobs; ++i) server.push(-1);
+    for (auto& w : workers) w.join();
+    ::close(server.listenFd);
+    ::unlink(socketPath);
+    return 0;
+}
+
+int clientCompile(const char* socketPath, const char* base) {
+    std::string req = std::string("COMPILE\n") + absolute(std::string(base) + EXT) + "\n" +
+                      absolute(std::string(base) + ".asm") + "\n";
+    std::string reply;
+    if (!request(socketPath, req, reply)) return 1;
+
+    int status;
+    std::size_t outBytes, errBytes;
+    std::size_t eol = reply.find('\n');
+    if (eol == std::string::npos ||
+        std::sscanf(reply.c_str(), "%d %zu %zu", &status, &outBytes, &errBytes) != 3 ||
+        reply.size() != eol + 1 + outBytes + errBytes) {
+        std::cerr << "ERROR: bad reply from compile server\n";
+        return 1;
+    }
+    std::cout << reply.substr(eol + 1, outBytes);
+    std::cerr << reply.substr(eol + 1 + outBytes);
+    return status;
+}
+
+int clientStats(const char* socketPath) {
+    std::string reply;
+    if (!request(socketPath, "STATS\n", reply)) return 1;
+    std::cout << reply;
+    return 0;
+}
+
+int clientStop(const char* socketPath) {
+    std::string reply;
+    return request(socketPath, "STOP\n", reply) && reply == "OK\n" ? 0 : 1;
+}
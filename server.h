@@ -0,0 +1,33 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include "compiler.h"
+
+
+// Compile server (compile --serve=<socket>): listens on a Unix domain
+// socket and compiles requests on `jobs` worker threads (0 means one per
+// core) with the given options. Each worker keeps one CompileContext
+// for its whole life, so requests are served from warm tables and
+// allocations. Runs until a client sends a stop request; returns the
+// process exit status. Refuses to start if anything but a stale socket
+// (one no server is listening on) is at socketPath.
+//
+// Protocol: one request per connection, each request a line.
+//   COMPILE\n<input path>\n<output path>\n
+//       -> "<status> <out bytes> <err bytes>\n" followed by the
+//          compiler's stdout text and then its stderr text
+//   STATS\n -> per-request latency percentiles (and cache counters) as text
+//            (percentiles from a log-bucket histogram, within about 2%)
+//   STOP\n  -> "OK\n", then the server shuts down
+int serve(const char* socketPath, const CompileOptions& opts, unsigned jobs);
+
+
+// Client side (compile --client=<socket>): have the server compile
+// <base>.fs25s2 into <base>.asm, relaying its messages and exit status.
+int clientCompile(const char* socketPath, const char* base);
+
+// Print the server's latency statistics / ask it to stop
+int clientStats(const char* socketPath);
+int clientStop(const char* socketPath);
+
+
+#endif // SERVER_H
@@ -0,0 +1,213 @@
+// serverTest.cpp (compile server checks behind `make servertest`)
+//
+// Runs serve() on a socket in a scratch directory, talks to it over the
+// wire protocol (server.h) and checks what a long-running server must
+// not get wrong:
+//   socket     serve() replaces a stale socket file but refuses a path
+//              that holds a regular file or a live server's socket
+//   stats      STATS counts and times the COMPILE requests
+//   accept     running out of descriptors while accepting does not stop
+//              the server; the waiting client is served once fds free up
+//   pipeline   a --pipeline compile that fails early leaves no scanner
+//              thread behind, and the worker compiles the next request
+#include "server.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const std::string& what) {
+        std::cout << (ok ? "ok      " : "FAILED  ") << what << '\n';
+        if (!ok) failures++;
+    }
+
+    std::string readReply(int fd) {
+        std::string reply;
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) reply.append(buf, static_cast<std::size_t>(n));
+        return reply;
+    }
+
+    // Connected socket to the server, -1 if nobody listens
+    int connectTo(const std::string& socketPath) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Send one request and return the whole reply ("" if nobody listens)
+    std::string request(const std::string& socketPath, const std::string& text) {
+        int fd = connectTo(socketPath);
+        if (fd < 0) return "";
+        std::string reply;
+        if (::send(fd, text.data(), text.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(text.size()))
+            reply = readReply(fd);
+        ::close(fd);
+        return reply;
+    }
+
+    bool waitForServer(const std::string& socketPath) {
+        for (int i = 0; i < 500; ++i) {
+            if (request(socketPath, "STATS\n").compare(0, 9, "requests ") == 0) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    // Threads in this process right now
+    int threadCount() {
+        DIR* d = opendir("/proc/self/task");
+        if (!d) return -1;
+        int n = 0;
+        while (dirent* e = readdir(d))
+            if (e->d_name[0] != '.') n++;
+        closedir(d);
+        return n;
+    }
+
+    // Status from a COMPILE reply's "<status> <out> <err>" head, -1 if none
+    int statusOf(const std::string& reply) {
+        return reply.empty() ? -1 : std::atoi(reply.c_str());
+    }
+}
+
+
+int main() {
+    char scratch[] = "/tmp/serverTestXXXXXX";
+    if (!mkdtemp(scratch)) {
+        std::cerr << "ERROR: cannot create a scratch directory\n";
+        return 1;
+    }
+    const std::string dir = scratch;
+    const std::string socketPath = dir + "/server.sock";
+
+    // A syntax error on the first statement, followed by far more tokens
+    // than the pipeline ring holds, so the producer is still scanning
+    // (or blocked on a full ring) when the parser gives up.
+    {
+        std::ofstream bad(dir + "/bad.fs25s2");
+        bad << "start var id_x ~ 0 :\n{\n  set ~ :\n";
+        for (int i = 0; i < 200000; ++i) bad << "  print id_x :\n";
+        bad << "}\ntrats\n";
+        std::ofstream good(dir + "/good.fs25s2");
+        good << "start var id_x ~ 7 :\n{\n  print id_x :\n}\ntrats\n";
+    }
+
+    CompileOptions opts;
+    opts.scanMode = ScanMode::Pipelined;
+
+    // a file that is not a socket is never removed
+    const std::string filePath = dir + "/notes.txt";
+    std::ofstream(filePath) << "keep me\n";
+    check(serve(filePath.c_str(), opts, 1) == 1, "socket: refuses a path holding a regular file");
+    std::string kept;
+    std::getline(std::ifstream(filePath), kept);
+    check(kept == "keep me", "socket: the regular file is left intact");
+
+    // a socket nobody listens on, as a killed server leaves it
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::cerr << "ERROR: cannot create a stale socket at " << socketPath << '\n';
+            return 1;
+        }
+        ::close(fd);
+    }
+
+    const int before = threadCount();
+    int served = -1;
+    std::thread server([&] { served = serve(socketPath.c_str(), opts, 1); });
+    if (!waitForServer(socketPath)) {
+        std::cerr << "ERROR: the server did not come up on " << socketPath << '\n';
+        return 1;
+    }
+    check(true, "socket: replaces a stale socket file");
+    const int idle = threadCount();   // + serve() and its one worker
+
+    check(serve(socketPath.c_str(), opts, 1) == 1, "socket: refuses a path a server is listening on");
+    check(waitForServer(socketPath), "socket: the running server still answers");
+
+    int status = statusOf(request(socketPath, "COMPILE\n" + dir + "/bad.fs25s2\n" + dir + "/bad.asm\n"));
+    check(status == 1, "pipeline: bad source fails with status 1 (got " + std::to_string(status) + ")");
+    // the reply is sent after the compile has ended, so nothing may linger
+    int after = threadCount();
+    check(after == idle, "pipeline: no scanner thread left (" + std::to_string(after) + " threads, "
+                         + std::to_string(idle) + " when idle)");
+    status = statusOf(request(socketPath, "COMPILE\n" + dir + "/good.fs25s2\n" + dir + "/good.asm\n"));
+    check(status == 0, "pipeline: next compile on the same worker succeeds");
+
+    const std::string statsHead = "requests 2\nlatency_us mean ";
+    check(request(socketPath, "STATS\n").compare(0, statsHead.size(), statsHead) == 0,
+          "stats: both compiles counted and timed");
+
+    // Cap descriptors at the lowest free one and connect: accept()
+    // returns the fd it had reserved while blocked, and the server's
+    // next accept() fails with EMFILE (the worker keeps that connection
+    // open, waiting for its request). Lift the cap, then both this
+    // client and a new one must be answered.
+    {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        int lowestFree = ::dup(fd);
+        ::close(lowestFree);
+        rlimit saved;
+        ::getrlimit(RLIMIT_NOFILE, &saved);
+        rlimit capped = saved;
+        capped.rlim_cur = static_cast<rlim_t>(lowestFree);
+        ::setrlimit(RLIMIT_NOFILE, &capped);
+
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        bool connected = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        ::setrlimit(RLIMIT_NOFILE, &saved);
+
+        std::string reply;
+        if (connected && ::send(fd, "STATS\n", 6, MSG_NOSIGNAL) == 6) reply = readReply(fd);
+        ::close(fd);
+        check(reply.compare(0, 9, "requests ") == 0, "accept: the connection accepted at the cap is answered");
+        check(request(socketPath, "STATS\n").compare(0, 9, "requests ") == 0,
+              "accept: the server outlives running out of descriptors");
+    }
+
+    check(request(socketPath, "STOP\n") == "OK\n", "stop: acknowledged");
+    server.join();
+    check(served == 0, "stop: serve() returns 0");
+    check(threadCount() == before, "stop: all server threads joined");
+
+    for (const char* f : {"bad.fs25s2", "bad.asm", "good.fs25s2", "good.asm", "notes.txt", "server.sock"})
+        ::unlink((dir + "/" + f).c_str());
+    ::rmdir(scratch);
+
+    if (failures) {
+        std::cout << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,122 @@
+// simdScan.cpp
+#include "simdScan.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SIMDSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    bool isBlank(char c) { return c==' ' || c=='\t' || c=='\r' || c=='\n'; }
+
+    const char* skipBlanksScalar(const char* p, const char* end, int& lines) {
+        while (p != end && isBlank(*p)) {
+            if (*p == '\n') lines++;
+            ++p;
+        }
+        return p;
+    }
+
+    const char* findCommentEndScalar(const char* p, const char* end) {
+        while (p != end && *p != '#' && *p != '\n') ++p;
+        return p;
+    }
+
+#ifdef SIMDSCAN_X86
+    // Bit i set <=> byte i is blank / is '\n'
+    inline void blankMasks16(const char* p, unsigned& blank, unsigned& nl) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i n = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i b = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), n));
+        blank = static_cast<unsigned>(_mm_movemask_epi8(b));
+        nl = static_cast<unsigned>(_mm_movemask_epi8(n));
+    }
+
+    const char* skipBlanksSse2(const char* p, const char* end, int& lines) {
+        while (end - p >= 16) {
+            unsigned blank, nl;
+            blankMasks16(p, blank, nl);
+            if (blank != 0xFFFFu) {
+                unsigned stop = static_cast<unsigned>(__builtin_ctz(~blank));
+                lines += __builtin_popcount(nl & ((1u << stop) - 1u));
+                return p + stop;
+            }
+            lines += __builtin_popcount(nl);
+            p += 16;
+        }
+        return skipBlanksScalar(p, end, lines);
+    }
+
+    const char* findCommentEndSse2(const char* p, const char* end) {
+        const __m128i hash = _mm_set1_epi8('#');
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned m = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, hash), _mm_cmpeq_epi8(v, newline))));
+            if (m) return p + __builtin_ctz(m);
+            p += 16;
+        }
+        return findCommentEndScalar(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* skipBlanksAvx2(const char* p, const char* end, int& lines) {
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i n = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+            __m256i b = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), n));
+            unsigned blank = static_cast<unsigned>(_mm256_movemask_epi8(b));
+            unsigned nl = static_cast<unsigned>(_mm256_movemask_epi8(n));
+            if (blank != 0xFFFFFFFFu) {
+                unsigned stop = static_cast<unsigned>(__builtin_ctz(~blank));
+                lines += __builtin_popcount(nl & ((1u << stop) - 1u));
+                return p + stop;
+            }
+            lines += __builtin_popcount(nl);
+            p += 32;
+        }
+        return skipBlanksSse2(p, end, lines);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCommentEndAvx2(const char* p, const char* end) {
+        const __m256i hash = _mm256_set1_epi8('#');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned m = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, hash), _mm256_cmpeq_epi8(v, newline))));
+            if (m) return p + __builtin_ctz(m);
+            p += 32;
+        }
+        return findCommentEndSse2(p, end);
+    }
+
+    const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif
+} // end anonymous namespace
+
+const char* skipBlanks(const char* p, const char* end, int& lines) {
+    // most tokens are separated by a single space: don't pay for a vector load
+    if (p != end && !isBlank(*p)) return p;
+#ifdef SIMDSCAN_X86
+    return HAS_AVX2 ? skipBlanksAvx2(p, end, lines) : skipBlanksSse2(p, end, lines);
+#else
+    return skipBlanksScalar(p, end, lines);
+#endif
+}
+
+const char* findCommentEnd(const char* p, const char* end) {
+#ifdef SIMDSCAN_X86
+    return HAS_AVX2 ? findCommentEndAvx2(p, end) : findCommentEndSse2(p, end);
+#else
+    return findCommentEndScalar(p, end);
+#endif
+}
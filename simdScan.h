@@ -0,0 +1,17 @@
+#ifndef SIMDSCAN_H
+#define SIMDSCAN_H
+
+
+// Vectorized helpers for the scanner's whitespace/comment skipping.
+// AVX2 is used when the CPU has it, SSE2 otherwise on x86-64, and a
+// plain loop everywhere else; all paths give identical results.
+
+// Skip a run of ' ', '\t', '\r', '\n' starting at p.
+// Returns the first other byte (or end) and adds the newlines passed to `lines`.
+const char* skipBlanks(const char* p, const char* end, int& lines);
+
+// First '#' or '\n' in [p, end), or end if there is none.
+const char* findCommentEnd(const char* p, const char* end);
+
+
+#endif // SIMDSCAN_H
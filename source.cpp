@@ -0,0 +1,59 @@
+// source.cpp
+#include "source.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+    const std::size_t READ_CHUNK = 64 * 1024;
+
+    bool readAll(int fd, std::vector<char>& buf) {
+        std::size_t used = 0;
+        for (;;) {
+            if (buf.size() - used < READ_CHUNK) buf.resize(used + READ_CHUNK * 4);
+            ssize_t n = ::read(fd, buf.data() + used, buf.size() - used);
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            used += static_cast<std::size_t>(n);
+        }
+        buf.resize(used);
+        return true;
+    }
+} // end anonymous namespace
+
+bool SourceBuffer::load(FILE* in) {
+    release();
+    int fd = fileno(in);
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                       PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+            size = static_cast<std::size_t>(st.st_size);
+            mapped = true;
+            return true;
+        }
+        // fall through: some filesystems refuse mmap, read instead
+    }
+
+    if (!readAll(fd, owned)) return false;
+    data = owned.data();
+    size = owned.size();
+    return true;
+}
+
+void SourceBuffer::release() {
+    if (mapped) munmap(const_cast<char*>(data), size);
+    mapped = false;
+    owned.clear();
+    owned.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+
+// The whole input program as one contiguous, read-only byte range.
+// Regular files are memory-mapped; anything else (pipes, a terminal)
+// is block-read into an owned buffer. Tokens copy their lexemes
+// inline, so the buffer only has to live while the file is scanned
+// (including any pipeline or parallel-lex workers reading it).
+struct SourceBuffer {
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    SourceBuffer() = default;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer() { release(); }
+
+    // Load everything readable from `in`. Returns false on a read error.
+    bool load(FILE* in);
+
+    // Unmap / free the current contents (safe to call repeatedly).
+    void release();
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+
+private:
+    bool mapped = false;
+    std::vector<char> owned;
+};
+
+
+#endif // SOURCE_H
@@ -0,0 +1,53 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+#include <atomic>
+#include <cstddef>
+
+
+// Bounded single-producer/single-consumer ring, lock-free.
+// Slots are filled and drained in place: the producer writes into
+// slotToFill() and then publish()es it; the consumer reads front()
+// and then pop()s it. N must be a power of two.
+template <typename T, std::size_t N>
+class SpscRing {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+public:
+    // ----- producer side -----
+
+    // Free slot to write into, or nullptr when the ring is full
+    T* slotToFill() {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) return nullptr;
+        return &slots[h & (N - 1)];
+    }
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // ----- consumer side -----
+
+    // Oldest published slot, or nullptr when the ring is empty
+    T* front() {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &slots[t & (N - 1)];
+    }
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Published but not yet popped (a snapshot when called concurrently)
+    std::size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    static constexpr std::size_t capacity() { return N; }
+
+private:
+    alignas(64) std::atomic<std::size_t> head{0};   // written by producer
+    alignas(64) std::atomic<std::size_t> tail{0};   // written by consumer
+    T slots[N];
+};
+
+
+#endif // SPSCRING_H
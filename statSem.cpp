@@ -1,120 +1,117 @@
 // statSem.cpp
 #include "statSem.h"
+#include "compiler.h"
 #include "token.h"
+#include "intern.h"
 #include <vector>
 #include <string>
-#include <iostream>
-#include <cstdlib>
-
-struct VarEntry {
-    std::string name;   // id_x
-    int defLine;        // line where defined
-    bool used;          // ever used?
-};
-
-static std::vector<VarEntry> STV;   // global symbol table (global option)
 
 // ------- helpers for reporting -------
 
-[[noreturn]] static void errorP3(const std::string& msg) {
-    std::cout << "ERROR in P3: " << msg << '\n';
-    std::exit(EXIT_FAILURE);
+void SemanticsPass::errorP3(const std::string& msg) {
+    cx.out << "ERROR in P3: " << msg << '\n';
+    throw CompileError{};
 }
 
-static void warningP3(const std::string& msg) {
-    std::cout << "WARNING in P3: " << msg << '\n';
+void SemanticsPass::warningP3(const std::string& msg) {
+    cx.out << "WARNING in P3: " << msg << '\n';
 }
 
 // ------- STV API (insert / verify / checkVars) -------
 
-static void stInsert(const Token& tk) {
+std::string SemanticsPass::nameOf(int sym) const {
+    return std::string(cx.symbols.name(sym));
+}
+
+// Symbols may still be interned while the table is in use (single-pass
+// mode, possibly with a pipelined scanner on another thread), so it
+// grows on demand instead of being sized from the interner.
+int& SemanticsPass::stSlot(int sym) {
+    std::size_t i = static_cast<std::size_t>(sym);
+    if (i >= STV.size()) STV.resize(i + 1, -1);
+    return STV[i];
+}
+
+void SemanticsPass::stInsert(const Token& tk) {
     // tk must be an identifier token
-    std::string name = tk.instance;
-    int line = tk.line;
+    int& slot = stSlot(tk.sym);
 
     // check redeclaration
-    for (const auto& e : STV) {
-        if (e.name == name) {
-            errorP3("variable '" + name + "' redefined on line " +
-                    std::to_string(line) +
-                    " (first defined on line " +
-                    std::to_string(e.defLine) + ")");
-        }
+    if (slot >= 0) {
+        errorP3("variable '" + std::string(tk.instance) + "' redefined on line " +
+                std::to_string(tk.line) +
+                " (first defined on line " +
+                std::to_string(defs[static_cast<std::size_t>(slot)].defLine) + ")");
     }
 
-    VarEntry e;
-    e.name = name;
-    e.defLine = line;
-    e.used = false;
-    STV.push_back(e);
+    slot = static_cast<int>(defs.size());
+    live.push_back(slot);
+    defs.push_back(VarEntry{tk.sym, tk.line});
 }
 
-static void stUse(const Token& tk) {
-    std::string name = tk.instance;
-    int line = tk.line;
-
-    for (auto& e : STV) {
-        if (e.name == name) {
-            e.used = true;
-            return;
-        }
+void SemanticsPass::stUse(const Token& tk) {
+    int slot = stSlot(tk.sym);
+    if (slot >= 0) {
+        defs[static_cast<std::size_t>(slot)].used = true;
+        return;
     }
 
-    // not found -> used before definition (global option)
-    errorP3("variable '" + name + "' used before definition on line " +
-            std::to_string(line));
+    // not found -> used before definition (or outside its block)
+    errorP3("variable '" + std::string(tk.instance) + "' used before definition on line " +
+            std::to_string(tk.line));
 }
 
-static void checkVars() {
-    for (const auto& e : STV) {
+// Blocks only ever add names (redeclaration is an error), so closing
+// one just unbinds what it declared: O(1) per declaration.
+void SemanticsPass::stPush() {
+    scopeMarks.push_back(live.size());
+}
+
+void SemanticsPass::stPop() {
+    std::size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    for (std::size_t i = mark; i < live.size(); ++i)
+        STV[static_cast<std::size_t>(defs[static_cast<std::size_t>(live[i])].sym)] = -1;
+    live.resize(mark);
+}
+
+void SemanticsPass::checkVars() {
+    for (const VarEntry& e : defs) {
         if (!e.used) {
-            warningP3("variable '" + e.name + "' defined on line " +
+            warningP3("variable '" + nameOf(e.sym) + "' defined on line " +
                       std::to_string(e.defLine) +
                       " but never used");
         }
     }
 }
 
-// ------- tree traversal -------
+// ------- tree pass -------
 
-// Any identifier token on a VARS or VARLIST node is a *definition*.
-// Any identifier token anywhere else is a *use*.
+SemanticsPass::SemanticsPass(CompileContext& cx, ScopeMode m) : cx(cx), mode(m) {}
 
-static void handleDefsInNode(Node* n) {
-    if (!n) return;
-    if (n->tk1.id == TokenID::IDENT_tk) stInsert(n->tk1);
-    if (n->tk2.id == TokenID::IDENT_tk) stInsert(n->tk2);
-    if (n->tk3.id == TokenID::IDENT_tk) stInsert(n->tk3);
+void SemanticsPass::define(const Token& tk) {
+    if (tk.id == TokenID::IDENT_tk) stInsert(tk);
 }
 
-static void handleUsesInNode(Node* n) {
-    if (!n) return;
-    if (n->tk1.id == TokenID::IDENT_tk) stUse(n->tk1);
-    if (n->tk2.id == TokenID::IDENT_tk) stUse(n->tk2);
-    if (n->tk3.id == TokenID::IDENT_tk) stUse(n->tk3);
+void SemanticsPass::use(const Token& tk) {
+    if (tk.id == TokenID::IDENT_tk) stUse(tk);
 }
 
-static void walk(Node* n) {
-    if (!n) return;
-
-    // Definitions:
-    if (n->label == NodeType::VARS || n->label == NodeType::VARLIST) {
-        handleDefsInNode(n);
-    } else {
-        // Any other identifier is a use:
-        handleUsesInNode(n);
-    }
+void SemanticsPass::openScope() {
+    if (mode == ScopeMode::Local) stPush();
+}
 
-    // preorder traversal of children
-    walk(n->child1);
-    walk(n->child2);
-    walk(n->child3);
-    walk(n->child4);
+void SemanticsPass::closeScope() {
+    if (mode == ScopeMode::Local) stPop();
 }
 
-void staticSemantics(Node* root) {
-    STV.clear();
-    walk(root);
+void SemanticsPass::finish() {
     checkVars();
-    // if no error was thrown, static semantics is OK (maybe warnings already printed)
+}
+
+void staticSemantics(CompileContext& cx, Node* root, ScopeMode mode) {
+    SemanticsPass sem(cx, mode);
+    traverse(root, sem);
+    sem.finish();
+    // if no error was thrown, static semantics is OK (maybe warnings already reported)
 }
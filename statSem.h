@@ -2,11 +2,87 @@
 #ifndef STATSEM_H
 #define STATSEM_H
 
+#include <cstddef>
+#include <string>
+#include <vector>
 #include "node.h"
+#include "visitor.h"
+
+struct CompileContext;
+
+// Global: every declaration is visible from its definition to the end
+// of the program (the project's "global option").
+// Local: declarations inside a block go out of scope at its closing
+// brace. Redeclaring a name that is still in scope is an error in both
+// modes, so every visible name maps to exactly one storage slot.
+enum class ScopeMode { Global, Local };
 
 // Run static semantics on the parse tree.
-// On error: prints "ERROR in P3: ..." and exits.
-// On warning(s): prints "WARNING in P3: ..." lines and returns normally.
-void staticSemantics(Node* root);
+// On error: reports "ERROR in P3: ..." on cx.out and throws CompileError.
+// On warning(s): reports "WARNING in P3: ..." lines and returns normally.
+void staticSemantics(CompileContext& cx, Node* root, ScopeMode mode = ScopeMode::Global);
+
+// The same checks as a tree pass (see visitor.h), so they can share one
+// traversal with other passes. Identifiers on VARS/VARLIST nodes are
+// definitions; the only other nodes that carry identifiers are uses.
+// Call finish() after the traversal to report the unused-variable
+// warnings.
+class SemanticsPass : public TreePass {
+public:
+    explicit SemanticsPass(CompileContext& cx, ScopeMode mode = ScopeMode::Global);
+    void finish();
+
+    static constexpr bool LEAVES = true;
+    using TreePass::leave;
+    void leave(NodeTag<NodeType::BLOCK>, Node*, int) { closeScope(); }
+
+    using TreePass::visit;
+    void visit(NodeTag<NodeType::BLOCK>, Node*, int)     { openScope(); }
+    void visit(NodeTag<NodeType::VARS>, Node* n, int)    { define(n->tk2()); }
+    void visit(NodeTag<NodeType::VARLIST>, Node* n, int) { define(n->tk1()); }
+    void visit(NodeTag<NodeType::READ>, Node* n, int)    { use(n->tk2()); }
+    void visit(NodeTag<NodeType::COND>, Node* n, int)    { use(n->tk2()); }
+    void visit(NodeTag<NodeType::LOOP>, Node* n, int)    { use(n->tk2()); }
+    void visit(NodeTag<NodeType::ASSIGN>, Node* n, int)  { use(n->tk2()); }
+    void visit(NodeTag<NodeType::R>, Node* n, int)       { use(n->tk1()); }
+
+private:
+    // both ignore tokens that are not identifiers
+    void define(const Token& tk);
+    void use(const Token& tk);
+    void openScope();
+    void closeScope();
+
+    // STV API (insert / verify / checkVars)
+    int& stSlot(int sym);
+    void stInsert(const Token& tk);
+    void stUse(const Token& tk);
+    void stPush();
+    void stPop();
+    void checkVars();
+
+    [[noreturn]] void errorP3(const std::string& msg);
+    void warningP3(const std::string& msg);
+    std::string nameOf(int sym) const;
+
+    // one per declaration, in definition order
+    struct VarEntry {
+        int sym;
+        int defLine;        // line where defined
+        bool used = false;  // ever used?
+    };
+
+    CompileContext& cx;
+    ScopeMode mode;
+
+    std::vector<VarEntry> defs;
+    // per interned symbol ID: index into defs of the declaration
+    // currently in scope, or -1
+    std::vector<int> STV;
+    // defs indices currently in scope, innermost last; scopeMarks holds
+    // the size of `live` when each open block was entered
+    std::vector<int> live;
+    std::vector<std::size_t> scopeMarks;
+};
 
 #endif
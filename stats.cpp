@@ -0,0 +1,111 @@
+// stats.cpp (per-phase cost report behind --stats)
+#include "stats.h"
+#include <chrono>
+#include <ctime>
+#include <new>
+#include <sys/resource.h>
+
+namespace {
+    double wallNowMs() {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    double cpuNowMs() {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) * 1e3 + static_cast<double>(ts.tv_nsec) / 1e6;
+    }
+
+    long peakRssKb() {
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;   // kilobytes on Linux
+    }
+
+    // Names are fixed identifiers and file names are user paths; escape
+    // what JSON requires
+    void writeString(std::ostream& os, const char* s) {
+        os << '"';
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') os << '\\' << *s;
+            else if (c < 0x20) {
+                const char* hex = "0123456789abcdef";
+                os << "\\u00" << hex[c >> 4] << hex[c & 15];
+            } else os << *s;
+        }
+        os << '"';
+    }
+
+    void writePhase(std::ostream& os, const PhaseStats& p) {
+        os << "{\"name\":";
+        writeString(os, p.name);
+        os << ",\"wall_ms\":" << p.wallMs << ",\"cpu_ms\":" << p.cpuMs
+           << ",\"peak_rss_kb\":" << p.peakRssKb
+           << ",\"allocs\":" << p.allocs << ",\"alloc_bytes\":" << p.allocBytes << '}';
+    }
+} // end anonymous namespace
+
+PhaseTimer::PhaseTimer(CompileStats& into, const char* name)
+    : into(into), name(name), wall0(wallNowMs()), cpu0(cpuNowMs()), allocs0(allocCounters()) {}
+
+// Runs while a CompileError unwinds the phase too, where an exception
+// escaping would terminate the process; a sample that cannot be stored
+// is dropped rather than abort the compile
+PhaseTimer::~PhaseTimer() {
+    AllocCounters a = allocCounters();
+    try {
+        into.phases.push_back(PhaseStats{
+            name, wallNowMs() - wall0, cpuNowMs() - cpu0, peakRssKb(),
+            a.count - allocs0.count, a.bytes - allocs0.bytes});
+    } catch (const std::bad_alloc&) {
+    }
+}
+
+void writeStatsJson(std::ostream& os, const CompileStats& st, const char* file, int status) {
+    PhaseStats total{"total", 0.0, 0.0, 0, 0, 0};
+    for (const PhaseStats& p : st.phases) {
+        total.wallMs += p.wallMs;
+        total.cpuMs += p.cpuMs;
+        total.allocs += p.allocs;
+        total.allocBytes += p.allocBytes;
+        if (p.peakRssKb > total.peakRssKb) total.peakRssKb = p.peakRssKb;
+    }
+
+    os << "{\"file\":";
+    writeString(os, file);
+    os << ",\"status\":" << status << ",\"cached\":" << (st.cached ? "true" : "false")
+       << ",\"phases\":[";
+    for (std::size_t i = 0; i < st.phases.size(); ++i) {
+        if (i) os << ',';
+        writePhase(os, st.phases[i]);
+    }
+    os << "],\"total\":";
+    writePhase(os, total);
+    os << ",\"passes\":[";
+    for (std::size_t i = 0; i < st.passes.size(); ++i) {
+        const PassStats& p = st.passes[i];
+        if (i) os << ',';
+        os << "{\"name\":";
+        writeString(os, p.name);
+        os << ",\"wall_ms\":" << p.wallMs << ",\"unit\":";
+        writeString(os, p.unit);
+        os << ",\"before\":" << p.before << ",\"after\":" << p.after;
+        if (!p.rules.empty()) {
+            os << ",\"rules\":{";
+            for (std::size_t r = 0; r < p.rules.size(); ++r) {
+                if (r) os << ',';
+                writeString(os, p.rules[r].name);
+                os << ':' << p.rules[r].hits;
+            }
+            os << '}';
+        }
+        os << '}';
+    }
+    os << ']';
+    os << ",\"counts\":{\"tokens\":" << st.tokens << ",\"nodes\":" << st.nodes
+       << ",\"symbols\":" << st.symbols << ",\"variables\":" << st.variables
+       << ",\"temps\":" << st.temps << ",\"labels\":" << st.labels
+       << ",\"instructions\":" << st.instructions << "}}\n";
+}
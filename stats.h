@@ -0,0 +1,78 @@
+#ifndef STATS_H
+#define STATS_H
+#include <cstddef>
+#include <ostream>
+#include <vector>
+#include "allocStats.h"
+
+
+// Cost of one compiler phase. CPU time and allocations are
+// process-wide, so with --pipeline they include the scanner thread (and
+// in batch mode any other compilations running at the same time).
+struct PhaseStats {
+    const char* name;
+    double wallMs;
+    double cpuMs;
+    long peakRssKb;           // process high-water mark when the phase ended
+    std::size_t allocs;       // operator new calls during the phase
+    std::size_t allocBytes;
+};
+
+// How often one rewrite rule of a pass fired
+struct RuleStats {
+    const char* name;
+    std::size_t hits;
+};
+
+// What one optimization pass did; in --stream mode it runs once per
+// statement and the runs are added up
+struct PassStats {
+    const char* name;
+    const char* unit;         // what before/after count: "nodes", "instructions" or "temps"
+    double wallMs;
+    std::size_t before;
+    std::size_t after;
+    std::vector<RuleStats> rules;   // per-rule hits, for passes that count them
+};
+
+// What one compilation did, for --stats
+struct CompileStats {
+    std::vector<PhaseStats> phases;   // in the order they ran
+    std::vector<PassStats> passes;    // optimization passes, in run order
+    bool cached = false;              // served from the compile cache
+
+    std::size_t tokens = 0;
+    std::size_t nodes = 0;
+    std::size_t symbols = 0;
+    std::size_t variables = 0;        // storage slots for program variables
+    std::size_t temps = 0;
+    std::size_t labels = 0;
+    std::size_t instructions = 0;     // emitted lines, STOP included
+};
+
+
+// Records a PhaseStats for the enclosing scope into `into` when it ends,
+// including when the phase is cut short by an error (if memory runs
+// out then, the sample is dropped instead)
+class PhaseTimer {
+public:
+    PhaseTimer(CompileStats& into, const char* name);
+    ~PhaseTimer();
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    CompileStats& into;
+    const char* name;
+    double wall0;
+    double cpu0;
+    AllocCounters allocs0;
+};
+
+
+// One JSON object on a single line: file, exit status, per-phase costs,
+// their total, the optimization passes and the counts
+void writeStatsJson(std::ostream& os, const CompileStats& st, const char* file, int status);
+
+
+#endif // STATS_H
@@ -1,10 +1,14 @@
 #ifndef TOKEN_H
 #define TOKEN_H
+#include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
+#include <string_view>
 
 
 // Token groups (can be printed via tokenName[])
-enum class TokenID {
+enum class TokenID : std::uint8_t {
 IDENT_tk, // identifier (must start with id_)
 NUM_tk, // integer (<= 8 digits)
 KW_tk, // keyword
@@ -14,7 +18,7 @@ ERR_tk // internal use
 };
 
 
-static const char* tokenName[] = {
+inline constexpr const char* tokenName[] = {
 "Identifier",
 "Number",
 "Keyword",
@@ -24,10 +28,79 @@ static const char* tokenName[] = {
 };
 
 
+// Exact token kinds: every keyword and operator has its own, so the
+// parser and code generator dispatch on one byte instead of comparing
+// lexemes. Names are printed via tokenKindName[].
+enum class TokenKind : std::uint8_t {
+IDENT_tk, NUM_tk,
+// keywords
+START_tk, TRATS_tk, WHILE_tk, VAR_tk, EXIT_tk, READ_tk, PRINT_tk,
+IF_tk, THEN_tk, SET_tk, FUNC_tk, PROGRAM_tk,
+// relational operators
+EQ_tk, NEQ_tk, LT_tk, LE_tk, GT_tk, GE_tk,
+// other operators and delimiters
+TILDE_tk, COLON_tk, SEMI_tk, PLUS_tk, MINUS_tk, STAR_tk, PERCENT_tk,
+LPAREN_tk, RPAREN_tk, LBRACE_tk, RBRACE_tk, LBRACKET_tk, RBRACKET_tk,
+EOF_tk, ERR_tk
+};
+
+
+inline constexpr const char* tokenKindName[] = {
+"Identifier", "Number",
+"start", "trats", "while", "var", "exit", "read", "print",
+"if", "then", "set", "func", "program",
+"eq", "neq", "<", "<=", ">", ">=",
+"~", ":", ";", "+", "-", "*", "%",
+"(", ")", "{", "}", "[", "]",
+"EOF", "Error"
+};
+
+
+// Group a kind belongs to
+constexpr TokenID tokenGroup(TokenKind k) {
+    return k == TokenKind::IDENT_tk ? TokenID::IDENT_tk
+         : k == TokenKind::NUM_tk   ? TokenID::NUM_tk
+         : k <= TokenKind::PROGRAM_tk ? TokenID::KW_tk
+         : k <= TokenKind::RBRACKET_tk ? TokenID::OP_tk
+         : k == TokenKind::EOF_tk   ? TokenID::EOFTk
+         : TokenID::ERR_tk;
+}
+
+
+// Lexeme text kept inline in the token. Identifiers and integers are
+// at most 8 characters and keywords at most 7, so a token never owns
+// heap memory and does not depend on the source buffer staying alive.
+struct Lexeme {
+    static constexpr std::size_t CAPACITY = 8;
+
+    Lexeme() : text{}, len(0) {}
+    Lexeme(std::string_view s) : len(static_cast<std::uint8_t>(s.size() < CAPACITY ? s.size() : CAPACITY)) {
+        std::memcpy(text, s.data(), len);
+    }
+    Lexeme(const char* s) : Lexeme(std::string_view(s)) {}
+
+    std::string_view view() const { return std::string_view(text, len); }
+    operator std::string_view() const { return view(); }
+    std::size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    bool operator==(std::string_view s) const { return view() == s; }
+    bool operator!=(std::string_view s) const { return view() != s; }
+
+private:
+    char text[CAPACITY];
+    std::uint8_t len;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Lexeme& l) { return os << l.view(); }
+
+
 struct Token {
-TokenID id;
-std::string instance;
+TokenID id;     // group (tokenGroup(kind))
+TokenKind kind;
+Lexeme instance;
 int line;
+int sym = -1;   // interned symbol ID for identifiers (see intern.h)
 };
 
 
@@ -0,0 +1,12 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+
+// Part of every compile-cache key: bump it whenever the generated code
+// or the messages can change for the same source and options, so stale
+// cache entries are never served. (Keys also include the identity of
+// the compiler binary, which covers a rebuild nobody bumped this for.)
+inline constexpr const char* COMPILER_VERSION = "P4 1.2";
+
+
+#endif // VERSION_H
@@ -0,0 +1,121 @@
+#ifndef VISITOR_H
+#define VISITOR_H
+
+#include <utility>
+#include <vector>
+#include "node.h"
+
+// Compile-time dispatched tree passes.
+//
+// A pass derives from TreePass and overloads
+//     void visit(NodeTag<NodeType::X>, Node* n, int depth)
+// for the node types it cares about (or defines one member template
+// and branches with `if constexpr` on T). dispatchNode() turns the
+// runtime label into a tag once per node; from there the call to the
+// pass's handler is resolved statically and can be inlined.
+//
+// traverse(root, a, b, ...) walks the tree once, preorder, with an
+// explicit stack, and hands every node to each pass in turn, so adding
+// an analysis does not add another walk of the tree.
+//
+// A pass that also needs to know when a subtree is finished (to close a
+// scope, say) sets `static constexpr bool LEAVES = true` and overloads
+// leave() the same way; the walk only pays for exit events when some
+// pass asks for them.
+
+template <NodeType T>
+struct NodeTag {
+    static constexpr NodeType type = T;
+};
+
+// Default: ignore every node type. Derived passes add
+// `using TreePass::visit;` so the defaults stay visible.
+struct TreePass {
+    static constexpr bool LEAVES = false;
+
+    template <NodeType T>
+    void visit(NodeTag<T>, Node*, int) {}
+
+    template <NodeType T>
+    void leave(NodeTag<T>, Node*, int) {}
+};
+
+template <class Pass>
+inline void dispatchNode(Pass& p, Node* n, int depth) {
+    switch (n->label) {
+        case NodeType::PROGRAM: p.visit(NodeTag<NodeType::PROGRAM>{}, n, depth); break;
+        case NodeType::VARS:    p.visit(NodeTag<NodeType::VARS>{}, n, depth);    break;
+        case NodeType::VARLIST: p.visit(NodeTag<NodeType::VARLIST>{}, n, depth); break;
+        case NodeType::BLOCK:   p.visit(NodeTag<NodeType::BLOCK>{}, n, depth);   break;
+        case NodeType::STATS:   p.visit(NodeTag<NodeType::STATS>{}, n, depth);   break;
+        case NodeType::MSTAT:   p.visit(NodeTag<NodeType::MSTAT>{}, n, depth);   break;
+        case NodeType::STAT:    p.visit(NodeTag<NodeType::STAT>{}, n, depth);    break;
+        case NodeType::READ:    p.visit(NodeTag<NodeType::READ>{}, n, depth);    break;
+        case NodeType::PRINT:   p.visit(NodeTag<NodeType::PRINT>{}, n, depth);   break;
+        case NodeType::COND:    p.visit(NodeTag<NodeType::COND>{}, n, depth);    break;
+        case NodeType::LOOP:    p.visit(NodeTag<NodeType::LOOP>{}, n, depth);    break;
+        case NodeType::ASSIGN:  p.visit(NodeTag<NodeType::ASSIGN>{}, n, depth);  break;
+        case NodeType::REL:     p.visit(NodeTag<NodeType::REL>{}, n, depth);     break;
+        case NodeType::EXP:     p.visit(NodeTag<NodeType::EXP>{}, n, depth);     break;
+        case NodeType::M:       p.visit(NodeTag<NodeType::M>{}, n, depth);       break;
+        case NodeType::N:       p.visit(NodeTag<NodeType::N>{}, n, depth);       break;
+        case NodeType::R:       p.visit(NodeTag<NodeType::R>{}, n, depth);       break;
+    }
+}
+
+template <class Pass>
+inline void dispatchLeave(Pass& p, Node* n, int depth) {
+    switch (n->label) {
+        case NodeType::PROGRAM: p.leave(NodeTag<NodeType::PROGRAM>{}, n, depth); break;
+        case NodeType::VARS:    p.leave(NodeTag<NodeType::VARS>{}, n, depth);    break;
+        case NodeType::VARLIST: p.leave(NodeTag<NodeType::VARLIST>{}, n, depth); break;
+        case NodeType::BLOCK:   p.leave(NodeTag<NodeType::BLOCK>{}, n, depth);   break;
+        case NodeType::STATS:   p.leave(NodeTag<NodeType::STATS>{}, n, depth);   break;
+        case NodeType::MSTAT:   p.leave(NodeTag<NodeType::MSTAT>{}, n, depth);   break;
+        case NodeType::STAT:    p.leave(NodeTag<NodeType::STAT>{}, n, depth);    break;
+        case NodeType::READ:    p.leave(NodeTag<NodeType::READ>{}, n, depth);    break;
+        case NodeType::PRINT:   p.leave(NodeTag<NodeType::PRINT>{}, n, depth);   break;
+        case NodeType::COND:    p.leave(NodeTag<NodeType::COND>{}, n, depth);    break;
+        case NodeType::LOOP:    p.leave(NodeTag<NodeType::LOOP>{}, n, depth);    break;
+        case NodeType::ASSIGN:  p.leave(NodeTag<NodeType::ASSIGN>{}, n, depth);  break;
+        case NodeType::REL:     p.leave(NodeTag<NodeType::REL>{}, n, depth);     break;
+        case NodeType::EXP:     p.leave(NodeTag<NodeType::EXP>{}, n, depth);     break;
+        case NodeType::M:       p.leave(NodeTag<NodeType::M>{}, n, depth);       break;
+        case NodeType::N:       p.leave(NodeTag<NodeType::N>{}, n, depth);       break;
+        case NodeType::R:       p.leave(NodeTag<NodeType::R>{}, n, depth);       break;
+    }
+}
+
+// One preorder walk (child1 before child2 before child3) feeding every
+// pass; leave() runs after a node's whole subtree has been visited
+template <class... Passes>
+void traverse(Node* root, Passes&... passes) {
+    constexpr bool leaves = (false || ... || Passes::LEAVES);
+
+    // depth < 0 marks the exit event of the node at depth ~depth
+    std::vector<std::pair<Node*, int>> stack;
+    if (root) stack.push_back({root, 0});
+
+    while (!stack.empty()) {
+        Node* n = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        if constexpr (leaves) {
+            if (depth < 0) {
+                ((Passes::LEAVES ? dispatchLeave(passes, n, ~depth) : void()), ...);
+                continue;
+            }
+            stack.push_back({n, ~depth});
+        }
+
+        (dispatchNode(passes, n, depth), ...);
+
+        // children pushed in reverse so child1 is visited first
+        if (n->child3()) stack.push_back({n->child3(), depth + 1});
+        if (n->child2()) stack.push_back({n->child2(), depth + 1});
+        if (n->child1()) stack.push_back({n->child1(), depth + 1});
+    }
+}
+
+#endif // VISITOR_H
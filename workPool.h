@@ -0,0 +1,78 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Runs a fixed set of independent tasks on a group of threads.
+// Task indices are dealt out in contiguous runs, one deque per worker.
+// A worker takes from the back of its own deque. When that is empty it
+// steals from the front of another worker's deque, so a few slow tasks
+// do not leave the other threads idle. Tasks never spawn more tasks,
+// which means the run is over once every deque is empty.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned workers) : queues(workers ? workers : 1) {
+        for (auto& q : queues) q = std::make_unique<Queue>();
+    }
+
+    unsigned workers() const { return static_cast<unsigned>(queues.size()); }
+
+    // Call task(i) once for every i in [0, count); returns when all are
+    // done. The calling thread works as worker 0. `task` must not throw.
+    template <typename F>
+    void run(std::size_t count, F task) {
+        const std::size_t n = queues.size();
+        for (std::size_t w = 0; w < n; ++w)
+            for (std::size_t i = w * count / n; i < (w + 1) * count / n; ++i)
+                queues[w]->items.push_back(i);
+
+        std::vector<std::thread> threads;
+        for (std::size_t w = 1; w < n; ++w)
+            threads.emplace_back([this, w, &task] { work(w, task); });
+        work(0, task);
+        for (auto& t : threads) t.join();
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::size_t> items;
+    };
+
+    bool popOwn(std::size_t w, std::size_t& item) {
+        Queue& q = *queues[w];
+        std::lock_guard<std::mutex> g(q.lock);
+        if (q.items.empty()) return false;
+        item = q.items.back();
+        q.items.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t thief, std::size_t& item) {
+        for (std::size_t k = 1; k < queues.size(); ++k) {
+            Queue& q = *queues[(thief + k) % queues.size()];
+            std::lock_guard<std::mutex> g(q.lock);
+            if (q.items.empty()) continue;
+            item = q.items.front();
+            q.items.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    template <typename F>
+    void work(std::size_t w, F& task) {
+        std::size_t item;
+        while (popOwn(w, item) || steal(w, item)) task(item);
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+};
+
+
+#endif // WORKPOOL_H